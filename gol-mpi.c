@@ -48,22 +48,73 @@
 */
 
 #include <stdio.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
 #include <mpi.h>
-#include <time.h> // Seed rand() with time(NULL)
+#include <stdint.h>
+#include <time.h> // Seed the random decisions with time(NULL)
+#include <fcntl.h>
+#include <sys/mman.h> // Map the blocks of OUT_OF_CORE into memory
+#include <sys/socket.h> // Stream frames to a viewer (STREAM_SOCKET)
+#include <sys/un.h>
+#include <errno.h>
 
 /* User controllable parameters */
 #define GRID_WIDTH 32                           // Set the width of the square grid (N)
                                                 // This value should not be a prime number and at least 8.
 
-#define TOTAL_GRID_SIZE GRID_WIDTH*GRID_WIDTH   // DO NOT CHANGE - calculate the size of the grid
+#define TOTAL_GRID_SIZE ((long long)GRID_WIDTH*GRID_WIDTH) // DO NOT CHANGE - calculate the size of the grid
+
+#define DIMENSIONS 2                            // Set to 3 to simulate a GRID_WIDTH^3 cube with 26
+                                                // neighbours per cell on a 3D grid of processors (any
+                                                // number of processors whose grid divides GRID_WIDTH).
+                                                // Prints the population per generation instead of a grid.
+
+#define RULE_3D "4555"                          // Set the 3D rule as "ElEuFlFu" (or "El,Eu,Fl,Fu"): a
+                                                // cell survives with El..Eu and is born with Fl..Fu of
+                                                // its 26 neighbours alive.
 
 #define N_GENERATIONS 500                       // Set the amount of generations to simulate
 #define GEN_DELAY_MS  100                       // Set the delay per generation in milliseconds
 
+#define RULE "B3/S23"                           // Set the rule in B/S notation. Digits may be followed by
+                                                // isotropic non-totalistic (Hensel) letters to select or
+                                                // (after a '-') exclude neighbourhood shapes, e.g. "B2-a/S12".
+
+#define NEIGHBOURHOOD NB_MOORE                  // Set the cells that count as neighbours: NB_MOORE (all
+                                                // eight), NB_VON_NEUMANN (up, down, left and right),
+                                                // NB_HEXAGONAL (six neighbours of a hexagonal grid that
+                                                // is drawn skewed) or any mask of the 3x3 cells in
+                                                // row-major order (bit 0: upper left, bit 8: lower right).
+                                                // Hensel letters in RULE require NB_MOORE.
+
+#define RULE_FILE ""                            // Set a Golly .rule file (@TABLE or @TREE) to simulate a
+                                                // cellular automaton with up to 255 states instead of RULE
+                                                // (requires KERNEL_TABLE). State 1 is drawn black, the
+                                                // states from 2 on in the colors of ARR_COLORS.
+
+#define MARGOLUS ""                             // Set a block rule in MCell notation to update 2x2 blocks
+                                                // instead of single cells, with the partition shifted by one
+                                                // cell every other generation (Margolus neighbourhood), e.g.
+                                                // "MS,D0;8;4;3;2;5;9;7;1;6;10;11;12;13;14;15" (billiard balls)
+                                                // or "MS,D15;14;13;3;11;5;6;1;7;9;10;2;12;4;8;0" (critters).
+                                                // The 16 numbers are the new states of the blocks 0..15
+                                                // (1: upper left, 2: upper right, 4: lower left, 8: lower
+                                                // right cell). Replaces RULE and KERNEL and requires an even
+                                                // length of the local grid.
+
+#define P_BIRTH  1.0                            // Set the probability that a cell is born when the rule says so
+#define P_DEATH  1.0                            // Set the probability that a cell dies when the rule says so
+#define P_UPDATE 1.0                            // Set the probability that a cell is updated at all in a
+                                                // generation (below 1 for asynchronous random updates).
+                                                // Probabilities below 1 require KERNEL_NAIVE, KERNEL_LUT
+                                                // or KERNEL_SEPARABLE.
+#define RANDOM_SEED 0                           // Set the seed of the random decisions (0: time at start).
+                                                // A seed gives the same result for any number of processors.
+
 #define START_RANDOM 1                          // Set to 1 to fill the grid randomly at start. If
                                                 // set to 0 then a glider will be spawned.
 
@@ -75,6 +126,123 @@
 #define COLOR_SUB_GRIDS 1                       // Set to 1 to activate a colored grid. Set to 0 to
                                                 // get the default BLACK/WHITE output.
 
+#define RENDERER RENDER_BLOCKS                  // Select how the terminal shows the cells: RENDER_BLOCKS
+                                                // draws every cell as two colored columns, RENDER_HALF packs
+                                                // 1x2 cells into one half-block character (upper cell in the
+                                                // foreground color) and RENDER_BRAILLE 2x4 cells into one
+                                                // Braille pattern (live cells as dots, without colors).
+
+#define VIEWPORT_W 0                            // Set to w > 0 to only draw a window of VIEWPORT_W x
+#define VIEWPORT_H 0                            // VIEWPORT_H cells whose upper left cell is at column
+#define VIEWPORT_X 0                            // VIEWPORT_X and row VIEWPORT_Y. Only the processors
+#define VIEWPORT_Y 0                            // whose blocks intersect it send their part to the root
+                                                // processor, the others never wait for the drawing.
+#define VIEWPORT_ZOOM 1                         // Set the number of cells per drawn cell in the viewport
+                                                // (z x z cells, drawn in the highest state among them).
+
+#define FRAME_EVERY 0                           // Set to k > 0 to write every k-th generation to a file
+                                                // instead of drawing it (all processors write their part
+                                                // of the file in parallel with MPI-IO).
+#define FRAME_FILE "frame%05d.pbm"              // Set the name of the frame files (printf pattern of the generation)
+#define FRAME_FORMAT FRAME_PBM                  // Set the format of the frames: FRAME_PBM (binary PBM, one
+                                                // black pixel per live cell, requires a multiple of 8 as
+                                                // length of the local grid) or FRAME_PGM (binary PGM, one
+                                                // grey pixel per FRAME_SCALE x FRAME_SCALE cells, the darker
+                                                // the more cells live).
+#define FRAME_SCALE 1                           // Set the cells per side of a FRAME_PGM pixel (must divide
+                                                // the length of the local grid).
+
+#define GIF_FILE ""                             // Set a file name to record the drawn generations as an
+                                                // animated GIF (requires DISTRIBUTE_DRAW 0). With a viewport
+                                                // or FRAME_EVERY the viewport is recorded (zoomed out by
+                                                // VIEWPORT_ZOOM, the entire grid if VIEWPORT_W is not set).
+#define GIF_SCALE 4                             // Set the pixels per side of a cell in the GIF
+
+#define DELTA_FILE ""                           // Set a file name to write the cells that changed in every
+                                                // drawn generation as a compact stream (see write_deltas).
+                                                // All processors write their part in parallel with MPI-IO.
+#define KEYFRAME_EVERY 100                      // Set the generations between full keyframes in DELTA_FILE
+                                                // (listed in the index DELTA_FILE.idx), 0 for none.
+#define REPLAY 0                                // Set to 1 to draw the recording DELTA_FILE on the root
+                                                // processor instead of simulating, starting at generation
+                                                // REPLAY_FROM (found via the nearest keyframe).
+#define REPLAY_FROM 0
+
+#define STREAM_SOCKET ""                        // Set the path of a Unix socket to stream the drawn cells
+                                                // (the viewport or the entire grid, both reduced by
+                                                // VIEWPORT_ZOOM) to a viewer process instead of drawing
+                                                // them (see stream_frame). Frames the viewer is not ready
+                                                // for are dropped, the simulation never waits for it.
+#define STREAM_VIEWER 0                         // Set to 1 to run the viewer instead of simulating: connect
+                                                // to STREAM_SOCKET and draw the frames as they arrive.
+
+#define CHECKPOINT_EVERY 0                      // Set to k > 0 to save the grid every k generations to a
+                                                // checkpoint file (CHECKPOINT_FILE, see write_checkpoint).
+#define CHECKPOINT_FILE "checkpoint%06d.gol"    // Set the name of the checkpoints (printf pattern of the generation)
+#define IO_RANKS 0                              // Set the number of processors (the last ones) reserved for
+                                                // writing checkpoints. The other processors hand over their
+                                                // blocks with non-blocking sends and continue at once. With
+                                                // 0 all processors write the checkpoints themselves.
+#define CHECKPOINT_FULL_EVERY 1                 // Set to n > 1 to save only every n-th checkpoint in full and
+                                                // the others incrementally: just the tiles that changed since
+                                                // the last full checkpoint (see write_checkpoint).
+#define RESTART_FILE ""                         // Set a checkpoint file to continue from instead of a new grid
+                                                // (an incremental one is applied to its full checkpoint)
+#define BOARD_FILE ""                           // Set a board file (see write_board) to start from instead of
+                                                // a new grid. Every processor maps it into memory and only
+                                                // unpacks its own tiles, so nothing is scattered.
+#define BOARD_WRITE ""                          // Set a file to save the grid after the last generation as
+                                                // a board file (not with OUT_OF_CORE)
+
+#define HALO_EXCHANGE 1                         // Set to 1 to exchange the borders in two phases (columns
+                                                // first, then full-width rows including the received
+                                                // ghost columns) so the corners arrive implicitly with
+                                                // 4 messages per generation. Set to 0 to send the
+                                                // corners separately (8 messages per generation).
+
+#define NODE_AWARE_LAYOUT 1                     // Set to 1 to give every node one contiguous super-block
+                                                // of the grid that is subdivided among its processors,
+                                                // so only the node perimeter is exchanged over the
+                                                // network. Set to 0 to place the processors row by row.
+
+#define HALO_DEPTH 1                            // Set the depth of the ghost ring. With a depth d > 1 the
+                                                // borders are exchanged (in two phases) only every d
+                                                // generations and d generations are computed per exchange.
+                                                // Must not exceed the length of the local grid. The grid
+                                                // is only drawn (and frames, deltas and checkpoints are
+                                                // only written) every d generations, so FRAME_EVERY,
+                                                // KEYFRAME_EVERY and CHECKPOINT_EVERY must be multiples of d.
+
+#define TEMPORAL_TILE 64                        // Set the edge length of the tiles that are advanced by
+                                                // HALO_DEPTH generations at once while they stay in cache
+                                                // (only used if HALO_DEPTH > 1, 0 to disable tiling).
+
+#define OUT_OF_CORE 0                           // Set to 1 to keep every processor's block in a memory-mapped
+                                                // file (OOC_FILE, one byte per cell) instead of in memory, for
+                                                // grids larger than the memory of all nodes. The block is
+                                                // streamed through memory in bands of OOC_BAND rows and
+                                                // HALO_DEPTH generations are applied per pass (so N_GENERATIONS
+                                                // must be a multiple of HALO_DEPTH). Prints the population
+                                                // per pass instead of a grid (no checkpoints, restart,
+                                                // board writing, frames, deltas, GIF, stream or viewport).
+#define OOC_FILE "block%05d.ooc"                // Set the name of the block files (printf pattern of the rank)
+#define OOC_BAND 64                             // Set the number of rows per band
+
+#define KERNEL KERNEL_LUT                       // Select the kernel that computes the next generation:
+                                                // KERNEL_NAIVE sums up the eight neighbours of every cell,
+                                                // KERNEL_LUT looks up the next state of 2x2 cells at once
+                                                // in a table indexed by the surrounding 4x4 window,
+                                                // KERNEL_SEPARABLE reuses vertical 3-cell column sums
+                                                // for a sliding horizontal window (one byte per cell,
+                                                // totalistic rules on NB_MOORE only),
+                                                // KERNEL_QUICKLIFE keeps a bit-packed copy of the local
+                                                // grid and only recomputes 8x8 blocks near changes,
+                                                // KERNEL_ADAPTIVE stores each tile either as a bitmap or
+                                                // as a list of live cells depending on its population
+                                                // (the last two require HALO_DEPTH 1),
+                                                // KERNEL_TABLE looks up the next state of every cell of a
+                                                // multi-state RULE_FILE in a table over all neighbourhoods.
+
 const char *ARR_COLORS[] = {                    // Background colors to use for coloring sub grids
         "\033[48;5;1m",         // RED          // (when activated)
         "\033[48;5;2m",         // GREEN
@@ -90,11 +258,55 @@ const char *ARR_COLORS[] = {                    // Background colors to use for
 /* System parameters - DO NOT CHANGE  */
 #define NUM_COLORS (sizeof(ARR_COLORS) / sizeof(const char *)) // Get the size of ARR_COLORS
 
+#define RENDER_BLOCKS   0       // Renderers (see RENDERER)
+#define RENDER_HALF     1
+#define RENDER_BRAILLE  2
+
 #define S_TOPLEFT       "\033[H"        // Set cursor to top left
 #define C_RST           "\033[0;39m"    // Reset color code to default
 #define C_B_BLACK       "\033[0;40m"    // Set background color black
 #define C_B_WHITE       "\033[0;47m"    // Set background color white
 
+#define KERNEL_NAIVE    0       // Kernel ids (see KERNEL)
+#define KERNEL_LUT      1
+#define KERNEL_SEPARABLE 2
+#define KERNEL_QUICKLIFE 3
+#define KERNEL_ADAPTIVE 4
+#define KERNEL_TABLE    5
+
+#define STOCHASTIC      (P_BIRTH < 1.0 || P_DEATH < 1.0 || P_UPDATE < 1.0)
+
+#define FRAME_PBM       0       // Frame formats (see FRAME_FORMAT)
+#define FRAME_PGM       1
+
+#define GIF_COLORS      16      // Colors in the palette of the GIF (a power of 2)
+#define GIF_MIN_CODE    4       // Bits per color, the initial LZW code size is one more
+
+#define RNG_STEP        0       // Streams of philox_random: the decisions of the stochastic rules,
+#define RNG_START       1       // the random start grid
+#define NB_MOORE        0x1EF   // Neighbourhood masks (see NEIGHBOURHOOD)
+#define NB_VON_NEUMANN  0x0AA
+#define NB_HEXAGONAL    0x1AB   // All but the upper right and lower left cell
+
+#define NB_ROW_ABOVE    0x007   // Neighbourhood cells in the row above / below and in the column to the left / right
+#define NB_ROW_BELOW    0x1C0
+#define NB_COL_LEFT     0x049
+#define NB_COL_RIGHT    0x124
+#define NB_UL           0x001   // Neighbourhood cells in the corners
+#define NB_UR           0x004
+#define NB_DL           0x040
+#define NB_DR           0x100
+
+#define QL_BLOCK        8       // Edge length of the blocks that can fall asleep (KERNEL_QUICKLIFE)
+#define QL_GROUP        8       // Edge length (in blocks) of the groups that are skipped as a whole
+
+#define AT_TILE         32      // Edge length of the tiles of KERNEL_ADAPTIVE (at most 32)
+#define AT_SPARSE_DIV   16      // A dense tile becomes sparse if less than 1/AT_SPARSE_DIV of its cells live
+#define AT_DENSE_DIV    8       // A sparse tile becomes dense if more than 1/AT_DENSE_DIV of its cells live
+
+#define RF_MAX_VARS     256     // Maximum number of variables in a rule file
+#define RF_MAX_TABLE    (1<<24) // Maximum number of entries of the state table
+
 #define TAG_UL  10 // Receiving value for upper left corner
 #define TAG_UR  20 // Receiving value for upper right corner
 #define TAG_DL  30 // Receiving value for down left corner
@@ -103,8 +315,79 @@ const char *ARR_COLORS[] = {                    // Background colors to use for
 #define TAG_DO  60 // Receiving values for downside border
 #define TAG_RI  70 // Receiving values for right border
 #define TAG_LE  80 // Receiving values for left border
+#define TAG_LO  90 // Receiving values for the lower side of a dimension (3D)
+#define TAG_HI 100 // Receiving values for the upper side of a dimension (3D)
+#define TAG_CKPT 110 // Sending blocks to the I/O processors
+#define TAG_VIEW 120 // Sending parts of the viewport to the root processor
+
+#define CKPT_HEADER 20  // Bytes in front of the cells of a checkpoint
+#define CKPT_INC_HEADER 28 // Bytes in front of the tiles of an incremental checkpoint
+#define CKPT_TILE 16    // Edge length of the tiles of incremental checkpoints (the whole block if it does not fit)
+#define BOARD_HEADER 16 // Bytes in front of the tiles of a board file
+#define BOARD_TILE 64   // Edge length of the tiles of a written board file (the whole block if it does not fit)
+#define VIEW_X ((VIEWPORT_W > 0)? VIEWPORT_X : 0)       // Cells of the viewport (the entire grid if VIEWPORT_W is not set)
+#define VIEW_Y ((VIEWPORT_W > 0)? VIEWPORT_Y : 0)
+#define VIEW_CELLS_W ((VIEWPORT_W > 0)? VIEWPORT_W : GRID_WIDTH)
+#define VIEW_CELLS_H ((VIEWPORT_W > 0)? VIEWPORT_H : GRID_WIDTH)
+#define VIEW_W ((VIEW_CELLS_W+VIEWPORT_ZOOM-1)/VIEWPORT_ZOOM) // Drawn cells per row / column of the viewport
+#define VIEW_H ((VIEW_CELLS_H+VIEWPORT_ZOOM-1)/VIEWPORT_ZOOM)
+#define VIEW_GATHERED (VIEWPORT_W > 0 || STREAM_SOCKET[0] || (GIF_FILE[0] && FRAME_EVERY > 0)) // Viewport collected by proc 0
+#define VIEWPORT_PIXELS (VIEW_GATHERED? VIEW_W*VIEW_H : 1) // Drawn cells of the viewport (1 if not gathered)
+
+unsigned char rule_table[512];  // Next state for every 3x3 neighbourhood (see parse_rule)
+int rule_totalistic;            // 1 if the rule only depends on the state and the number of neighbours
+int n_states = 2;               // Number of cell states
+unsigned char *state_table;     // Next state for every neighbourhood of a rule file (see load_rule_file)
+int table_pos[9], table_cells;  // Row-major 3x3 positions of the digits of a state table index
+int table_mask;                 // The cells a rule file counts as neighbours (as NEIGHBOURHOOD)
+unsigned char margolus_table[16]; // Next state for every 2x2 block (see parse_margolus)
+uint32_t random_seed;           // Key of the random decisions (identical on all processors)
+int local_y0, local_x0;         // Position of the local grid in the entire grid
+MPI_Comm compute_comm;          // The processors that compute the grid (all but the I/O processors)
 
 
+/**
+ * @brief Parse a rule in B/S notation into a lookup table over all 3x3 neighbourhoods.
+ *
+ * The table is indexed with the nine cells of a neighbourhood in row-major order (bit 0: upper
+ * left, bit 4: centre, bit 8: lower right). Every digit of the birth (B) and survival (S) part
+ * selects all neighbourhoods with that many live neighbours among the cells of mask. Hensel
+ * letters after a digit only select the named shapes (with all rotations and reflections), a
+ * '-' in front of the letters selects all other shapes, e.g. "B2-a/S12". Letters require the
+ * full Moore neighbourhood.
+ *
+ * @param rule          The rule, e.g. "B3/S23" (case insensitive, B and S in any order).
+ * @param mask          The cells that count as neighbours (see NEIGHBOURHOOD).
+ * @param table         The table of 512 entries that receives the next state for every neighbourhood.
+ * @param totalistic    Set to 1 if the rule only depends on the state and the number of neighbours.
+ * @return              0 on success, -1 if the rule is malformed.
+ */
+int parse_rule(const char *rule, int mask, unsigned char table[512], int *totalistic);
+
+/**
+ * @brief Compile a Golly rule file into a table over all neighbourhoods.
+ *
+ * The first @TABLE or @TREE section of the file is used. Tables may use the Moore, von Neumann
+ * or hexagonal neighbourhood, variables (bound: a variable that appears several times takes the
+ * same value each time) and the rotate, reflect and permute symmetries. Trees may use the Moore
+ * or von Neumann neighbourhood. Either is compiled into state_table, which holds the next state
+ * for every combination of the states of the cells at table_pos (a number with n_states digits,
+ * the centre is the lowest digit), so at most RF_MAX_TABLE combinations are possible.
+ *
+ * @param text          The content of the rule file.
+ * @return              0 on success, the line of the first error or -1 if the file is incomplete or too large.
+ */
+int load_rule_file(const char *text);
+
+/**
+ * @brief Parse a block rule in MCell notation ("MS,D" followed by 16 numbers separated by ';' or ',').
+ *
+ * @param rule          The rule, e.g. "MS,D0;8;4;3;2;5;9;7;1;6;10;11;12;13;14;15".
+ * @param table         The table of 16 entries that receives the next state for every 2x2 block.
+ * @return              0 on success, -1 if the rule is malformed.
+ */
+int parse_margolus(const char *rule, unsigned char table[16]);
+
 /**
  * @brief Transform one grid into a concatenation of several smaller squares.
  *
@@ -135,6 +418,35 @@ void transform_from_distribution(int grid[TOTAL_GRID_SIZE], int edge_length);
  */
 void draw_grid(int grid[TOTAL_GRID_SIZE], int edge_length);
 
+/**
+ * @brief Collect the viewport (see VIEWPORT_W, the entire grid if it is not set) on the root processor.
+ *
+ * Every processor whose block intersects the viewport reduces its part to drawn cells (the
+ * highest state of each VIEWPORT_ZOOM x VIEWPORT_ZOOM cells) and sends the rectangle of drawn
+ * cells it touches to the root processor, which merges them (drawn cells on block borders
+ * arrive from several processors). The other processors return at once. The parts are sent
+ * without waiting, so the root processor may lag one frame behind (see close_viewport).
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param edge_length   The length of one side of the local grid.
+ * @param block_of_rank The block index of every rank (see get_block_layout).
+ * @param view          Receives the drawn cells of the viewport row by row (root processor only).
+ */
+void gather_viewport(const int *local_grid, int edge_length, const int *block_of_rank, int *view);
+
+/**
+ * @brief Draw the viewport collected by gather_viewport.
+ *
+ * @param view          The drawn cells of the viewport.
+ * @param edge_length   The length of the subgrids (for COLOR_SUB_GRIDS).
+ */
+void draw_viewport(const int *view, int edge_length);
+
+/**
+ * @brief Wait until the root processor took the last part sent by gather_viewport.
+ */
+void close_viewport(void);
+
 /**
  * @brief Distributed version of draw_grid. Draw the local grid.
  *
@@ -148,6 +460,229 @@ void draw_grid(int grid[TOTAL_GRID_SIZE], int edge_length);
  */
 void draw_local_grid(int *local_grid, int edge_length);
 
+/**
+ * @brief Append a frame to the animated GIF GIF_FILE.
+ *
+ * The file is created on the first call with the size of that frame, so all frames must have
+ * the same size. Only the bounding rectangle of the cells that changed since the previous frame
+ * is encoded (with LZW); the rest of the previous frame stays on screen. Dead cells are white,
+ * state 1 black and higher states colored.
+ *
+ * @param cells         The cells of the frame row by row (the entire grid or the viewport).
+ * @param w             Cells per row of the frame.
+ * @param h             Rows of the frame.
+ */
+void write_gif_frame(const int *cells, int w, int h);
+
+/**
+ * @brief Finish and close the GIF file if one was written.
+ */
+void close_gif(void);
+
+/**
+ * @brief Append the cells that changed since the previous call to the delta stream DELTA_FILE.
+ *
+ * The stream starts with "GOLDELTA" and the varints GRID_WIDTH and n_states. Every call adds
+ * a record: the varint generation, one byte that is 1 for a keyframe and 0 otherwise and the
+ * varint length of the record data in bytes, followed by one block per processor with changes:
+ * the varint number of changed cells, then per cell the varint distance of its index
+ * (y*GRID_WIDTH+x) to the previous cell of the block (to 0 for the first) and, if n_states > 2,
+ * the varint new state. A keyframe holds all live cells (the changes to an empty grid), so
+ * replaying can start there. Varints store 7 bits per byte, lowest first, with the high bit
+ * set on all but the last byte. The blocks are placed with an exclusive scan of their lengths
+ * and written collectively. Must be called by all processors.
+ *
+ * The offsets of the keyframes are appended to an index file: "GOLINDEX" followed by 16 bytes
+ * per keyframe, the generation and the offset of the record as 64 bit little endian numbers.
+ *
+ * @param file          The delta stream opened by all processors.
+ * @param index         The index file (only used on processor 0).
+ * @param end           The length of the stream so far, advanced by the record (same on all processors).
+ * @param local_grid    A pointer to the local grid.
+ * @param prev_grid     The local grid of the previous call (all 0 before the first), receives local_grid.
+ * @param edge_length   The length of one side of the local grid.
+ * @param gen           The generation of local_grid.
+ * @param keyframe      1 to write a keyframe (the first record must be one).
+ */
+void write_deltas(MPI_File file, FILE *index, MPI_Offset *end, const int *local_grid, int *prev_grid, int edge_length, int gen, int keyframe);
+
+/**
+ * @brief Draw the recording DELTA_FILE from generation REPLAY_FROM on.
+ *
+ * The last keyframe at or before REPLAY_FROM is looked up in the index (with a binary search),
+ * so only the records from there on are read. Without an index the whole stream is read.
+ */
+void replay_deltas(void);
+
+/**
+ * @brief Check whether a viewer waits for the next frame on STREAM_SOCKET (root processor only).
+ *
+ * Opens the socket on the first call and takes a connecting viewer if none is connected. The
+ * bytes of the last frame the viewer has not taken yet are handed on without waiting.
+ *
+ * @return              1 if a viewer is connected and has taken the previous frame, 0 otherwise.
+ */
+int stream_ready(void);
+
+/**
+ * @brief Send the drawn cells of a generation to the viewer (only if stream_ready returned 1).
+ *
+ * The stream uses the records of the delta stream (see write_deltas) with a single block of
+ * cell indices y*w+x. It starts with "GOLVIDEO" and the varints w, h and n_states, followed by
+ * a keyframe; every further record holds the cells that changed since the previous frame that
+ * was sent, so dropped generations need no record of their own. Nothing waits for the viewer:
+ * the rest of the record is sent by the following calls of stream_ready.
+ *
+ * @param cells         The drawn cells row by row.
+ * @param w             The number of cells per row.
+ * @param h             The number of rows.
+ * @param gen           The generation.
+ */
+void stream_frame(const int *cells, int w, int h, int gen);
+
+/**
+ * @brief Disconnect the viewer and remove STREAM_SOCKET if it was opened.
+ */
+void close_stream(void);
+
+/**
+ * @brief Connect to STREAM_SOCKET (waiting for the simulation) and draw the frames until it ends.
+ */
+void view_stream(void);
+
+/**
+ * @brief Write blocks of the grid into the checkpoint of their generation (see CHECKPOINT_FILE).
+ *
+ * A checkpoint is independent of the number of processors: "GOLCHECK", then GRID_WIDTH, the
+ * generation and n_states as 32 bit little endian numbers, followed by one byte per cell of the
+ * entire grid in row-major order. Every processor of comm writes the rows of its blocks at
+ * their offsets with MPI-IO. Must be called by all processors of comm.
+ *
+ * An incremental checkpoint starts with "GOLCHINC", GRID_WIDTH, the generation, n_states, the
+ * generation of its full checkpoint and the tile size. Then follow the tiles that differ from
+ * the full checkpoint, each as row and column of the upper left cell and one byte per cell.
+ * The processors place their tiles one after the other via an exclusive scan of their lengths.
+ *
+ * @param comm          The processors that write the checkpoint.
+ * @param n_blocks      The number of blocks of the calling processor (at least 1).
+ * @param blocks        The blocks as packed by checkpoint.
+ * @param edge_length   The length of one side of a block.
+ */
+void write_checkpoint(MPI_Comm comm, int n_blocks, int **blocks, int edge_length);
+
+/**
+ * @brief Save the local grid in a checkpoint.
+ *
+ * The local grid is packed into buf: generation, row and column of the upper left cell, the
+ * generation of the full checkpoint and the number of tiles, followed by the cells of a full
+ * checkpoint or by the tiles (row, column, cells) that differ from base_grid. With IO_RANKS > 0
+ * buf is sent to an I/O processor without waiting (req completes once it arrived, at the latest
+ * when the next checkpoint starts), otherwise all processors write the checkpoint together.
+ * Must be called by all processors.
+ *
+ * @param buf           A buffer for checkpoint_length(edge_length) values.
+ * @param req           The request of the previous send (MPI_REQUEST_NULL at first).
+ * @param local_grid    A pointer to the local grid.
+ * @param base_grid     The local grid at the last full checkpoint (updated by a full checkpoint),
+ *                      NULL if all checkpoints are full.
+ * @param base_gen      The generation of the last full checkpoint (gen for a full checkpoint).
+ * @param edge_length   The length of one side of the local grid.
+ * @param gen           The generation of local_grid.
+ */
+void checkpoint(int *buf, MPI_Request *req, const int *local_grid, int *base_grid, int base_gen, int edge_length, int gen);
+
+/**
+ * @brief Get the size of the largest checkpoint packet of a local grid (every tile changed).
+ *
+ * @param edge_length   The length of one side of the local grid.
+ * @return              The number of values.
+ */
+int checkpoint_length(int edge_length);
+
+/**
+ * @brief Serve as an I/O processor: collect the blocks of the computing processors and write the checkpoints.
+ *
+ * I/O processor i serves the computing processors i, i+IO_RANKS, ... and returns once all of
+ * them sent the generation -1.
+ *
+ * @param io_comm       The I/O processors.
+ * @param n_compute     The number of computing processors.
+ */
+void io_server(MPI_Comm io_comm, int n_compute);
+
+/**
+ * @brief Get the I/O processor that writes the checkpoints of a computing processor (IO_RANKS > 0).
+ *
+ * @param rank          The rank of the computing processor.
+ * @param n_compute     The number of computing processors.
+ * @return              The rank of the I/O processor in MPI_COMM_WORLD.
+ */
+int io_processor(int rank, int n_compute);
+
+/**
+ * @brief Read the local grid from a checkpoint (RESTART_FILE). Aborts if it does not fit.
+ *
+ * Checkpoints do not depend on the decomposition, so the number of processors may differ from
+ * the run that saved it: every processor reads its own block through a subarray view with
+ * collective MPI-IO. The tiles of an incremental checkpoint are applied to its full checkpoint
+ * (CHECKPOINT_FILE of the generation in its header), every processor taking the parts that
+ * overlap its block. Must be called by all processors.
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param edge_length   The length of one side of the local grid.
+ * @return              The generation of the checkpoint.
+ */
+int read_checkpoint(int *local_grid, int edge_length);
+
+/**
+ * @brief Save the grid as a board file (BOARD_WRITE) with MPI-IO. Must be called by all processors.
+ *
+ * A board file is "GOLBOARD", then GRID_WIDTH and the edge length of its tiles as 32 bit little
+ * endian numbers, followed by the square tiles in row-major order. A tile holds its rows with
+ * one bit per cell (leftmost cell in the lowest bit), every row padded to whole bytes. The
+ * tiles of a processor's block are consecutive in every row of tiles, so each processor writes
+ * one piece per row of tiles. Only for two states.
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param edge_length   The length of one side of the local grid.
+ */
+void write_board(const int *local_grid, int edge_length);
+
+/**
+ * @brief Map a board file (BOARD_FILE) into memory for reading. Aborts if it does not fit the grid.
+ *
+ * @param length        Receives the length of the mapping (for munmap).
+ * @param tile          Receives the edge length of the tiles.
+ * @return              The mapped board file.
+ */
+const unsigned char *map_board(size_t *length, int *tile);
+
+/**
+ * @brief Unpack cells of one row of a mapped board file. Only the pages of the tiles that hold
+ * the cells are touched, so every processor only reads its own part of the board.
+ *
+ * @param board         The mapped board file (see map_board).
+ * @param tile          The edge length of its tiles.
+ * @param y             The row in the entire grid.
+ * @param x             The column of the first cell in the entire grid.
+ * @param w             The number of cells.
+ * @param cells         Receives the cells (0 or 1).
+ */
+void unpack_board_row(const unsigned char *board, int tile, int y, int x, int w, int *cells);
+
+/**
+ * @brief Write the entire grid to a PBM or PGM file (see FRAME_FORMAT) with MPI-IO.
+ *
+ * Every processor converts its local grid into the bytes of its part of the image and writes
+ * them collectively through a subarray file view placed after the header, so the grid is
+ * never gathered on one processor. Must be called by all processors.
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param edge_length   The length of one side of the local grid.
+ * @param gen           The generation (inserted into FRAME_FILE).
+ */
+void write_frame(const int *local_grid, int edge_length, int gen);
+
 /**
  * @brief Get the eight neighbours of a processor (with wrap around).
  *
@@ -159,16 +694,78 @@ void draw_local_grid(int *local_grid, int edge_length);
  *      5   6   7
  *
  * @param proc_ids      An array that will be filled with the neighbour ranks for each direction.
- * @param rank          The rank to find the neighbours for.
+ * @param rank          The rank (block index, see get_block_layout) to find the neighbours for.
  * @param n_procs       The total amount of processors. Must be the square of an integer.
  */
 void get_neighbour_ids(int proc_ids[8], int rank, int n_procs);
 
+/**
+ * @brief Decide which block of the grid each processor is responsible for.
+ *
+ * Without NODE_AWARE_LAYOUT processor i simply computes block i (row by row). With it, the
+ * processors are grouped by shared-memory node and every node receives a contiguous
+ * super-block of nr x nc blocks (nr * nc = processors per node) that is subdivided among
+ * its processors. Falls back to the row-by-row layout if the nodes have different sizes
+ * or the super-blocks do not tile the grid.
+ *
+ * @param block_of_rank An array of n_procs entries that will receive the block index of every rank.
+ * @param rank_of_block An array of n_procs entries that will receive the rank computing every block.
+ * @param rank          The rank of the calling processor.
+ * @param n_procs       The total amount of processors. Must be the square of an integer.
+ */
+void get_block_layout(int *block_of_rank, int *rank_of_block, int rank, int n_procs);
+
+/**
+ * @brief Exchange the borders with all eight neighbours using separate corner messages.
+ *
+ * Every processor sends its four corners and its four borders and receives the same
+ * from its neighbours (8 messages per generation). Corners and borders that are not part
+ * of NEIGHBOURHOOD are neither sent nor received (e.g. 4 messages for NB_VON_NEUMANN).
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param width         The length of one side of the local grid.
+ * @param neigh_procs   The eight neighbour ranks (see get_neighbour_ids).
+ * @param ups           Receives the row above, including both corners (width+2 values).
+ * @param downs         Receives the row below, including both corners (width+2 values).
+ * @param lefts         Receives the column to the left (width values).
+ * @param rights        Receives the column to the right (width values).
+ */
+void exchange_eight_way(int *local_grid, int width, int neigh_procs[8], int *ups, int *downs, int *lefts, int *rights);
+
+/**
+ * @brief Exchange the borders in two phases, folding the corners into the row messages.
+ *
+ * First the left and right columns are swapped with the horizontal neighbours. Then the
+ * top and bottom rows are swapped with the vertical neighbours, extended by the ghost
+ * values that were just received. The corner cells of the diagonal neighbours travel
+ * along with these rows, so only 4 messages per generation are needed. Columns and rows
+ * that are not part of NEIGHBOURHOOD are skipped.
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param width         The length of one side of the local grid.
+ * @param neigh_procs   The eight neighbour ranks (see get_neighbour_ids).
+ * @param ups           Receives the row above, including both corners (width+2 values).
+ * @param downs         Receives the row below, including both corners (width+2 values).
+ * @param lefts         Receives the column to the left (width values).
+ * @param rights        Receives the column to the right (width values).
+ */
+void exchange_two_phase(int *local_grid, int width, int neigh_procs[8], int *ups, int *downs, int *lefts, int *rights);
+
+/**
+ * @brief Check whether an option that acts every k-th time (e.g. FRAME_EVERY) is due.
+ *
+ * @param n             The generation (or count).
+ * @param k             The period of the option, 0 if it is disabled.
+ * @return              1 if k > 0 and n is a multiple of k, 0 otherwise.
+ */
+int every(long long n, int k);
+
 /**
  * @brief Update each cell of a local grid, taking into account surrounding grids.
  *
  * @param g             A pointer to the local grid.
  * @param width         The length of one side of the local grid.
+ * @param gen           The current generation (selects the random decisions).
  * @param ul            The corner value of the top left processor.
  * @param ur            The corner value of the top right processor.
  * @param dl            The corner value of the lower left processor.
@@ -178,159 +775,719 @@ void get_neighbour_ids(int proc_ids[8], int rank, int n_procs);
  * @param lefts         Array with adjacent values of the processor to the left.
  * @param rights        Array with adjacent values of the processor to the right.
  */
-void update_local_grid(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights);
+void update_local_grid(int *g, int width, int gen, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights);
 
 /**
- * @brief Main entry point.
+ * @brief Update the 2x2 blocks of the Margolus partition of a generation.
  *
- * @param argc          Argument counter.
- * @param argv          Argument vector.
+ * Even generations use blocks at even coordinates, which never cross the border of an
+ * even-sized local grid, so no values are exchanged. Odd generations use the blocks shifted by
+ * one cell: the first column and row of the right and lower neighbours are fetched (columns
+ * first, so the corner arrives with the row), the blocks of the shifted local grid are updated
+ * and the last row and column are returned the same way. Each odd generation thus moves one
+ * column and one row in two directions with 4 messages instead of exchanging a full halo.
+ *
+ * @param g             A pointer to the local grid.
+ * @param width         The length of one side of the local grid (even).
+ * @param gen           The current generation (selects the partition).
+ * @param neigh_procs   The eight neighbour ranks (see get_neighbour_ids).
  */
-int main(int argc, char** argv) {
-
-        /* MPI Initialisation */
-        int size, my_rank;
-        MPI_Init(&argc, &argv);
-        MPI_Comm_size(MPI_COMM_WORLD, &size); // Get the total amount of processors
-        MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); // Get the current rank
-        if (ceilf(sqrt(size)) != sqrt(size)) {
-                fprintf(stdout, "M is not square, aborting (processors = %d).\n",size);
-                exit(1);
-        }
-
-        char processor_name[MPI_MAX_PROCESSOR_NAME];
-        int name_len;
-        MPI_Get_processor_name(processor_name, &name_len); // Get the processor name
-
-        /* Determine local responsibility */
-        const int local_grid_size = TOTAL_GRID_SIZE / size; // Get local grid size (distribute grid on M processors)
-        if (ceilf(sqrt(local_grid_size)) != sqrt(local_grid_size)) {
-                fprintf(stdout, "Local grid is not a square (local_grid_edge = %f).\n", sqrt(local_grid_size));
-                exit(1);
-        }
-        const int local_edge_length = (int)sqrt(local_grid_size); // Get the length of one side of the local grid
-
-        /* Allocate memory for the local grid */
-        int *local_grid = malloc(sizeof(int) * local_grid_size);
+void margolus_step(int *g, int width, int gen, int neigh_procs[8]);
 
-        /* Initialise entire grid and communicate it to all processors */
-        int grid[TOTAL_GRID_SIZE] = {0};
-        if (!my_rank) {
-                /* Proc 0 initialises and distributes data */
-                if (!START_RANDOM && GRID_WIDTH > 3) {
-                        /* Create a glider in the upper left corner */
-                        grid[GRID_WIDTH+3]=1;
-                        grid[GRID_WIDTH*2+1]=1;
-                        grid[GRID_WIDTH*2+3]=1;
-                        grid[GRID_WIDTH*3+2]=1;
-                        grid[GRID_WIDTH*3+3]=1;
-                } else {
-                        srand(time(NULL)); // Seed PRNG
-                        for (int i=0; i<TOTAL_GRID_SIZE; i++)
-                                grid[i] = rand()%2; // Set random 0 or 1
-                }
+/**
+ * @brief Exchange a ghost ring of several cells depth in two phases.
+ *
+ * The local grid is copied into the centre of deep_grid, then blocks of depth columns are
+ * swapped with the left and right neighbours (using col_type) and finally blocks of depth
+ * full-width rows (including the ghost columns) are swapped with the upper and lower neighbours.
+ *
+ * @param local_grid    A pointer to the local grid.
+ * @param deep_grid     A pointer to the local grid with a ghost ring, (width+2*depth)^2 cells.
+ * @param width         The length of one side of the local grid.
+ * @param depth         The depth of the ghost ring. Must not exceed width.
+ * @param neigh_procs   The eight neighbour ranks (see get_neighbour_ids).
+ * @param col_type      A vector type selecting width rows of depth cells in deep_grid.
+ */
+void exchange_deep(int *local_grid, int *deep_grid, int width, int depth, int neigh_procs[8], MPI_Datatype col_type);
 
-                /* Transform grid for easy distribution */
-                transform_for_distribution(grid, local_edge_length);
-        }
+/**
+ * @brief Advance the local grid by several generations with temporal tiling.
+ *
+ * The local grid is processed in tiles of TEMPORAL_TILE cells. Each tile is copied together
+ * with depth rings of context from deep_grid into a small buffer and advanced depth
+ * generations while it stays in cache. The valid region shrinks by one ring per generation
+ * (a trapezoid in time), so neighbouring tiles compute their overlap redundantly but never
+ * need each other's results.
+ *
+ * @param g             A pointer to the local grid that receives the state after depth generations.
+ * @param width         The length of one side of the local grid.
+ * @param depth         The number of generations to compute (depth of the ghost ring).
+ * @param gen           The current generation (selects the random decisions).
+ * @param deep_grid     The current generation with a ghost ring of depth cells (see exchange_deep).
+ */
+void update_local_grid_tiled(int *g, int width, int depth, int gen, const int *deep_grid);
 
-        /* Distribute the entire grid across all processors */
-        MPI_Scatter(grid, local_grid_size, MPI_INT, local_grid, local_grid_size, MPI_INT, 0, MPI_COMM_WORLD);
-        /* Each processor does now have a part of the grid in local_grid */
+/**
+ * @brief Compute the next generation of a region with the kernel selected by KERNEL.
+ *
+ * With probabilities below 1 (see P_BIRTH) every change the rule makes is only kept if a
+ * random number drawn for the cell and generation falls below its probability.
+ *
+ * @param g             A pointer to the first cell of the region that receives the next generation.
+ * @param gstride       The length of one row of g.
+ * @param w             The width of the region.
+ * @param h             The height of the region.
+ * @param cg            The current generation of the region surrounded by one ring of context values,
+ *                      followed by one spare row and column.
+ * @param stride        The length of one row of cg.
+ * @param gen           The current generation.
+ * @param gy            The row of the first cell of the region in the entire grid (may be off the grid).
+ * @param gx            The column of the first cell of the region in the entire grid (may be off the grid).
+ */
+void step_region(int *g, int gstride, int w, int h, const int *cg, int stride, int gen, int gy, int gx);
 
-        fprintf(stdout, "[%d|%d] (%s): Local grid size = %dx%d\n", my_rank, size, processor_name, local_edge_length, local_edge_length);
+/**
+ * @brief Draw a reproducible random number for a cell in a generation.
+ *
+ * A counter-based generator (Philox-2x32 with 10 rounds): the number is a pure function
+ * of the seed, the stream, the generation and the cell, so every processor draws the same
+ * number for a cell no matter how the grid is distributed or how often the cell is computed.
+ * The counter holds the generation and the low word of the cell; the stream and the high
+ * word of the cell are added to the key, so no two draws of a run share a counter and key
+ * (for grids of up to 2^63 cells).
+ *
+ * @param seed          The seed (see RANDOM_SEED).
+ * @param stream        What the number is drawn for (RNG_STEP or RNG_START).
+ * @param gen           The generation.
+ * @param cell          The index of the cell in the entire grid.
+ * @return              A uniformly distributed 32 bit number.
+ */
+uint32_t philox_random(uint32_t seed, int stream, uint32_t gen, uint64_t cell);
 
-        /* Synchronize all processors */
-        MPI_Barrier(MPI_COMM_WORLD);
-        if (!my_rank) {
-                fprintf(stdout, "\nReady to start? Press ENTER to continue.");
-                fflush(stdout);
-                getchar();
-                system("clear");
-        }
+/**
+ * @brief Start state of a cell of a new grid.
+ *
+ * A random state drawn with philox_random (so the grid only depends on RANDOM_SEED, not on
+ * the number of processors or on who initialises it) if START_RANDOM is set, otherwise the
+ * glider in the upper left corner.
+ *
+ * @param gy            The row of the cell in the entire grid.
+ * @param gx            The column of the cell in the entire grid.
+ * @return              The state of the cell.
+ */
+int start_cell(int gy, int gx);
 
-        /* Determine all eight neighbour processors */
-        int neigh_procs[8] = {0};
-        get_neighbour_ids(neigh_procs, my_rank, size);
+/**
+ * @brief Kernel: compute the next generation by looking up the 3x3 neighbourhood of every cell in the rule table.
+ *
+ * @param g             A pointer to the first cell of the region that receives the next generation.
+ * @param gstride       The length of one row of g.
+ * @param w             The width of the region.
+ * @param h             The height of the region.
+ * @param cg            The current generation of the region surrounded by one ring of context values.
+ * @param stride        The length of one row of cg.
+ */
+void step_naive(int *g, int gstride, int w, int h, const int *cg, int stride);
 
-        /* Prepare some values for the context from the other processes */
-        int up_left, up_right, down_left, down_right;
-        int *my_ups = malloc(sizeof(int) * local_edge_length);
-        int *my_lefts = malloc(sizeof(int) * local_edge_length);
-        int *my_rights = malloc(sizeof(int) * local_edge_length);
-        int *my_downs = malloc(sizeof(int) * local_edge_length);
+/**
+ * @brief Kernel: compute the next generation of 2x2 cells per table lookup.
+ *
+ * The 4x4 window around a 2x2 block is packed into a 16 bit index (top row in the highest
+ * nibble, leftmost cell in the highest bit of a nibble) and looked up in a table of 65536
+ * entries holding the next state of the four centre cells. The rows of the window are
+ * shifted along by two cells per block, so only two cells per row are loaded per lookup.
+ * For odd sizes the last block reads one spare row/column of cg (which must hold 0 or 1)
+ * and is clipped.
+ *
+ * @param g             A pointer to the first cell of the region that receives the next generation.
+ * @param gstride       The length of one row of g.
+ * @param w             The width of the region.
+ * @param h             The height of the region.
+ * @param cg            The current generation of the region surrounded by one ring of context values.
+ * @param stride        The length of one row of cg.
+ */
+void step_lut(int *g, int gstride, int w, int h, const int *cg, int stride);
 
-        /* Game of Life - Loop */
-        for (int gen=0; gen < N_GENERATIONS; gen++) {
-                /* Synchronize all processors */
-                MPI_Barrier(MPI_COMM_WORLD);
+/**
+ * @brief Kernel: compute the next generation from reused column sums.
+ *
+ * For every row the vertical sums of three cells are computed once per column and the
+ * neighbour count of a cell is the sum of three adjacent column sums minus the cell
+ * itself. Rows are processed in byte buffers with simple loops without dependencies
+ * between cells, so the compiler can vectorize them. Requires a totalistic rule and NB_MOORE.
+ *
+ * @param g             A pointer to the first cell of the region that receives the next generation.
+ * @param gstride       The length of one row of g.
+ * @param w             The width of the region.
+ * @param h             The height of the region.
+ * @param cg            The current generation of the region surrounded by one ring of context values.
+ * @param stride        The length of one row of cg.
+ */
+void step_separable(int *g, int gstride, int w, int h, const int *cg, int stride);
 
-                /* Draw the grid */
-                if (DISTRIBUTE_DRAW)
-                        /* Let each processor draw parts of the grid (for use on a raspberry pi cluster) */
-                        draw_local_grid(local_grid, local_edge_length);
-                else {
-                        /* Gather all distributed fields so proc 0 can display everything */
-                        MPI_Gather(local_grid, local_grid_size, MPI_INT, grid, local_grid_size, MPI_INT, 0, MPI_COMM_WORLD);
+/**
+ * @brief Kernel: compute the next generation of a multi-state rule by looking up every cell in the state table.
+ *
+ * @param g             A pointer to the first cell of the region that receives the next generation.
+ * @param gstride       The length of one row of g.
+ * @param w             The width of the region.
+ * @param h             The height of the region.
+ * @param cg            The current generation of the region surrounded by one ring of context values.
+ * @param stride        The length of one row of cg.
+ */
+void step_table(int *g, int gstride, int w, int h, const int *cg, int stride);
 
-                        /* Processor 0 */
-                        if (!my_rank) {
+/**
+ * @brief Engine: compute the next generation on a bit-packed grid with sleeping blocks.
+ *
+ * A QuickLife-like engine. The engine keeps its own bit-packed copy of the local grid (with
+ * the ghost ring) that is divided into blocks of QL_BLOCK x QL_BLOCK cells. A block is only
+ * recomputed if it or one of its eight neighbour blocks changed in the previous generation
+ * or if adjacent ghost cells changed; all other blocks are asleep because their next state
+ * cannot differ from the current one. The blocks are grouped into QL_GROUP x QL_GROUP groups
+ * with a counter of awake blocks, so sleeping groups are skipped in O(1). Only cells of
+ * changed blocks are written back to g.
+ *
+ * The bit-packed copy is created from g on the first call, afterwards g must only be changed
+ * by this engine.
+ *
+ * @param g             A pointer to the local grid.
+ * @param width         The length of one side of the local grid.
+ * @param ul            The corner value of the top left processor.
+ * @param ur            The corner value of the top right processor.
+ * @param dl            The corner value of the lower left processor.
+ * @param dr            The corner value of the lower right processor.
+ * @param ups           Array with adjacent values of the processor above.
+ * @param downs         Array with adjacent values of the processor below.
+ * @param lefts         Array with adjacent values of the processor to the left.
+ * @param rights        Array with adjacent values of the processor to the right.
+ */
+void quicklife_step(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights);
+
+/**
+ * @brief Engine: compute the next generation on tiles that are either dense or sparse.
+ *
+ * The engine keeps its own copy of the local grid divided into tiles of AT_TILE x AT_TILE
+ * cells. Densely populated tiles are stored as bit rows and advanced bit-sliced. Sparsely
+ * populated tiles are stored as a list of live cells and only the cells next to live cells
+ * are evaluated, so memory and work on near-empty tiles are proportional to the number of
+ * live cells (B0 rules are not supported). After every generation a tile switches its
+ * representation if its population crosses AT_SPARSE_DIV / AT_DENSE_DIV (with hysteresis).
+ * Only changed cells are written back to g.
+ *
+ * The copy is created from g on the first call, afterwards g must only be changed by this engine.
+ *
+ * @param g             A pointer to the local grid.
+ * @param width         The length of one side of the local grid.
+ * @param ul            The corner value of the top left processor.
+ * @param ur            The corner value of the top right processor.
+ * @param dl            The corner value of the lower left processor.
+ * @param dr            The corner value of the lower right processor.
+ * @param ups           Array with adjacent values of the processor above.
+ * @param downs         Array with adjacent values of the processor below.
+ * @param lefts         Array with adjacent values of the processor to the left.
+ * @param rights        Array with adjacent values of the processor to the right.
+ */
+void adaptive_step(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights);
+
+/**
+ * @brief Run the simulation in three dimensions (DIMENSIONS 3).
+ *
+ * The GRID_WIDTH^3 cube is distributed on a periodic 3D Cartesian grid of processors
+ * (MPI_Dims_create). Every processor stores its box with one ghost layer as one byte per
+ * cell. The ghost layers are exchanged one dimension after the other with subarray
+ * datatypes that include the ghost layers of the dimensions already exchanged, so the 12
+ * edge and 8 corner neighbours arrive implicitly with 6 messages instead of 26. The next
+ * generation is computed bit-sliced: the rows along x are packed into 64 bit words and the
+ * 27 cells of every neighbourhood are summed with bitwise adders (64 cells at once).
+ *
+ * @param my_rank       The rank of the calling processor.
+ * @param size          The total amount of processors.
+ */
+void run_3d(int my_rank, int size);
+
+/**
+ * @brief Run the simulation with the blocks in memory-mapped files (OUT_OF_CORE 1).
+ *
+ * Every processor maps its block from a file and streams it through memory in bands of
+ * OOC_BAND rows. A pass applies HALO_DEPTH generations as a wavefront: generation t is computed
+ * for the rows of a band as soon as generation t-1 holds the row below, so every band buffer
+ * only keeps two rows of the previous band, and the last generation overwrites the rows that
+ * were read before. The first and last HALO_DEPTH rows and columns are saved while a pass
+ * writes them, so the ghost ring of the next pass is exchanged (in two phases) without
+ * touching the file. Memory per processor is about HALO_DEPTH * OOC_BAND rows of the block.
+ *
+ * @param my_rank       The rank of the calling processor.
+ * @param size          The number of computing processors.
+ */
+void run_out_of_core(int my_rank, int size);
+
+/**
+ * @brief Main entry point.
+ *
+ * @param argc          Argument counter.
+ * @param argv          Argument vector.
+ */
+int main(int argc, char** argv) {
+
+        /* MPI Initialisation */
+        int size, my_rank;
+        MPI_Init(&argc, &argv);
+        MPI_Comm_size(MPI_COMM_WORLD, &size); // Get the total amount of processors
+        MPI_Comm_rank(MPI_COMM_WORLD, &my_rank); // Get the current rank
+        if (DIMENSIONS == 3) {
+                run_3d(my_rank, size);
+                MPI_Finalize();
+                return 0;
+        }
+        if (REPLAY) {
+                if (!my_rank)
+                        replay_deltas();
+                MPI_Finalize();
+                return 0;
+        }
+        if (STREAM_VIEWER) {
+                if (!my_rank)
+                        view_stream();
+                MPI_Finalize();
+                return 0;
+        }
+
+        /* Reserve the last IO_RANKS processors for writing checkpoints */
+        if (IO_RANKS > 0 && size < 2*IO_RANKS) {
+                fprintf(stdout, "IO_RANKS exceeds the computing processors, aborting (processors = %d).\n", size);
+                exit(1);
+        }
+        const int is_io = my_rank >= size-IO_RANKS;
+        MPI_Comm group_comm;
+        MPI_Comm_split(MPI_COMM_WORLD, is_io, my_rank, &group_comm);
+        if (is_io) {
+                io_server(group_comm, size-IO_RANKS);
+                MPI_Comm_free(&group_comm);
+                MPI_Finalize();
+                return 0;
+        }
+        compute_comm = group_comm;
+        MPI_Comm_size(compute_comm, &size);
+        MPI_Comm_rank(compute_comm, &my_rank);
+        if (ceilf(sqrt(size)) != sqrt(size)) {
+                fprintf(stdout, "M is not square, aborting (processors = %d).\n",size);
+                exit(1);
+        }
+
+        /* Compile the rule */
+        if (parse_rule(RULE, NEIGHBOURHOOD, rule_table, &rule_totalistic)) {
+                fprintf(stdout, "Invalid rule, aborting (rule = %s).\n", RULE);
+                exit(1);
+        }
+        if (KERNEL == KERNEL_SEPARABLE && NEIGHBOURHOOD != NB_MOORE) {
+                fprintf(stdout, "KERNEL_SEPARABLE requires NB_MOORE (neighbourhood = 0x%X).\n", NEIGHBOURHOOD);
+                exit(1);
+        }
+        if (KERNEL == KERNEL_SEPARABLE && !rule_totalistic) {
+                fprintf(stdout, "KERNEL_SEPARABLE requires a totalistic rule (rule = %s).\n", RULE);
+                exit(1);
+        }
+        if (KERNEL == KERNEL_ADAPTIVE && rule_table[0]) {
+                fprintf(stdout, "KERNEL_ADAPTIVE does not support B0 rules (rule = %s).\n", RULE);
+                exit(1);
+        }
+        if ((KERNEL == KERNEL_QUICKLIFE || KERNEL == KERNEL_ADAPTIVE) && STOCHASTIC) {
+                fprintf(stdout, "KERNEL_QUICKLIFE and KERNEL_ADAPTIVE require P_BIRTH, P_DEATH and P_UPDATE 1.\n");
+                exit(1);
+        }
+        if (MARGOLUS[0] && parse_margolus(MARGOLUS, margolus_table)) {
+                fprintf(stdout, "Invalid Margolus rule, aborting (rule = %s).\n", MARGOLUS);
+                exit(1);
+        }
+        if (MARGOLUS[0] && (RULE_FILE[0] || STOCHASTIC || HALO_DEPTH > 1)) {
+                fprintf(stdout, "MARGOLUS requires HALO_DEPTH 1, no RULE_FILE and P_BIRTH, P_DEATH and P_UPDATE 1.\n");
+                exit(1);
+        }
+        if ((KERNEL == KERNEL_TABLE) != (RULE_FILE[0] != 0)) {
+                fprintf(stdout, "KERNEL_TABLE and RULE_FILE must be used together (rule file = \"%s\").\n", RULE_FILE);
+                exit(1);
+        }
+        if (KERNEL == KERNEL_TABLE) {
+                /* Proc 0 reads the rule file, all processors compile it */
+                char *text = NULL;
+                long length = -1;
+                if (!my_rank) {
+                        FILE *f = fopen(RULE_FILE, "r");
+                        if (f) {
+                                fseek(f, 0, SEEK_END);
+                                length = ftell(f);
+                                rewind(f);
+                                text = malloc(length+1);
+                                length = fread(text, 1, length, f);
+                                fclose(f);
+                        }
+                }
+                MPI_Bcast(&length, 1, MPI_LONG, 0, compute_comm);
+                if (length < 0) {
+                        fprintf(stdout, "Cannot read the rule file, aborting (rule file = %s).\n", RULE_FILE);
+                        exit(1);
+                }
+                if (my_rank)
+                        text = malloc(length+1);
+                MPI_Bcast(text, (int)length, MPI_CHAR, 0, compute_comm);
+                text[length] = 0;
+
+                const int line = load_rule_file(text);
+                free(text);
+                if (line) {
+                        fprintf(stdout, "Invalid rule file, aborting (rule file = %s, line = %d).\n", RULE_FILE, line);
+                        exit(1);
+                }
+                if (table_mask & ~NEIGHBOURHOOD) {
+                        fprintf(stdout, "NEIGHBOURHOOD lacks cells of the rule file (rule file = %s).\n", RULE_FILE);
+                        exit(1);
+                }
+        }
+
+        if ((BOARD_FILE[0] || BOARD_WRITE[0]) && n_states != 2) {
+                fprintf(stdout, "Board files require two states (board file = %s).\n", BOARD_FILE[0]? BOARD_FILE : BOARD_WRITE);
+                exit(1);
+        }
+        if (BOARD_FILE[0] && RESTART_FILE[0]) {
+                fprintf(stdout, "BOARD_FILE and RESTART_FILE cannot be used together (board file = %s).\n", BOARD_FILE);
+                exit(1);
+        }
+        if (OUT_OF_CORE) {
+                if (IO_RANKS > 0 || MARGOLUS[0] || KERNEL == KERNEL_QUICKLIFE || KERNEL == KERNEL_ADAPTIVE) {
+                        fprintf(stdout, "OUT_OF_CORE requires IO_RANKS 0, no MARGOLUS and neither KERNEL_QUICKLIFE nor KERNEL_ADAPTIVE.\n");
+                        exit(1);
+                }
+                if (RESTART_FILE[0] || CHECKPOINT_EVERY > 0 || BOARD_WRITE[0] || DELTA_FILE[0] || FRAME_EVERY > 0 ||
+                    GIF_FILE[0] || STREAM_SOCKET[0] || VIEWPORT_W > 0) {
+                        fprintf(stdout, "OUT_OF_CORE does not support RESTART_FILE, CHECKPOINT_EVERY, BOARD_WRITE, DELTA_FILE, FRAME_EVERY, GIF_FILE, STREAM_SOCKET and VIEWPORT_W.\n");
+                        exit(1);
+                }
+                if (N_GENERATIONS % HALO_DEPTH) {
+                        fprintf(stdout, "OUT_OF_CORE runs whole passes, N_GENERATIONS must be a multiple of HALO_DEPTH (depth = %d).\n", HALO_DEPTH);
+                        exit(1);
+                }
+                run_out_of_core(my_rank, size);
+                MPI_Finalize();
+                return 0;
+        }
+
+        char processor_name[MPI_MAX_PROCESSOR_NAME];
+        int name_len;
+        MPI_Get_processor_name(processor_name, &name_len); // Get the processor name
+
+        /* Determine local responsibility */
+        const int local_grid_size = TOTAL_GRID_SIZE / size; // Get local grid size (distribute grid on M processors)
+        if (ceilf(sqrt(local_grid_size)) != sqrt(local_grid_size)) {
+                fprintf(stdout, "Local grid is not a square (local_grid_edge = %f).\n", sqrt(local_grid_size));
+                exit(1);
+        }
+        const int local_edge_length = (int)sqrt(local_grid_size); // Get the length of one side of the local grid
+        if ((KERNEL == KERNEL_QUICKLIFE || KERNEL == KERNEL_ADAPTIVE) && HALO_DEPTH > 1) {
+                fprintf(stdout, "KERNEL_QUICKLIFE and KERNEL_ADAPTIVE require HALO_DEPTH 1 (depth = %d).\n", HALO_DEPTH);
+                exit(1);
+        }
+        if (GIF_FILE[0] && DISTRIBUTE_DRAW) {
+                fprintf(stdout, "GIF_FILE requires DISTRIBUTE_DRAW 0 (gif file = %s).\n", GIF_FILE);
+                exit(1);
+        }
+        if (GIF_FILE[0] && ((long long)VIEW_W*GIF_SCALE > 0xFFFF || (long long)VIEW_H*GIF_SCALE > 0xFFFF)) {
+                fprintf(stdout, "The GIF exceeds 65535 pixels per side, increase VIEWPORT_ZOOM (gif file = %s).\n", GIF_FILE);
+                exit(1);
+        }
+        if (STREAM_SOCKET[0] && (DISTRIBUTE_DRAW || FRAME_EVERY > 0 || GIF_FILE[0])) {
+                fprintf(stdout, "STREAM_SOCKET requires DISTRIBUTE_DRAW 0, FRAME_EVERY 0 and no GIF_FILE (stream socket = %s).\n", STREAM_SOCKET);
+                exit(1);
+        }
+        if (VIEWPORT_W > 0 && (VIEWPORT_H <= 0 || VIEWPORT_X < 0 || VIEWPORT_Y < 0 || VIEWPORT_ZOOM < 1 ||
+                               VIEWPORT_X+VIEWPORT_W > GRID_WIDTH || VIEWPORT_Y+VIEWPORT_H > GRID_WIDTH)) {
+                fprintf(stdout, "The viewport must lie within the grid (viewport = %dx%d at %d,%d, zoom = %d).\n",
+                        VIEWPORT_W, VIEWPORT_H, VIEWPORT_X, VIEWPORT_Y, VIEWPORT_ZOOM);
+                exit(1);
+        }
+        if (VIEW_GATHERED && VIEWPORT_ZOOM < 1) {
+                fprintf(stdout, "VIEWPORT_ZOOM must be at least 1 (zoom = %d).\n", VIEWPORT_ZOOM);
+                exit(1);
+        }
+        if (FRAME_EVERY > 0 && FRAME_FORMAT == FRAME_PBM && local_edge_length % 8) {
+                fprintf(stdout, "FRAME_PBM requires a multiple of 8 as local grid length (local_grid_edge = %d).\n", local_edge_length);
+                exit(1);
+        }
+        if (FRAME_EVERY > 0 && FRAME_FORMAT == FRAME_PGM && local_edge_length % FRAME_SCALE) {
+                fprintf(stdout, "FRAME_SCALE must divide the local grid length (local_grid_edge = %d).\n", local_edge_length);
+                exit(1);
+        }
+        if (MARGOLUS[0] && local_edge_length % 2) {
+                fprintf(stdout, "MARGOLUS requires an even local grid (local_grid_edge = %d).\n", local_edge_length);
+                exit(1);
+        }
+        if (HALO_DEPTH > 1 && (FRAME_EVERY % HALO_DEPTH || (DELTA_FILE[0] && KEYFRAME_EVERY % HALO_DEPTH) || CHECKPOINT_EVERY % HALO_DEPTH)) {
+                fprintf(stdout, "FRAME_EVERY, KEYFRAME_EVERY and CHECKPOINT_EVERY must be multiples of HALO_DEPTH (depth = %d).\n", HALO_DEPTH);
+                exit(1);
+        }
+        if (HALO_DEPTH > local_edge_length) {
+                fprintf(stdout, "Halo depth exceeds the local grid (depth = %d, local_grid_edge = %d).\n", HALO_DEPTH, local_edge_length);
+                exit(1);
+        }
+
+        /* Allocate memory for the local grid */
+        int *local_grid = malloc(sizeof(int) * local_grid_size);
+
+        /* Assign the blocks of the grid to the processors */
+        int *block_of_rank = malloc(sizeof(int) * size);
+        int *rank_of_block = malloc(sizeof(int) * size);
+        get_block_layout(block_of_rank, rank_of_block, my_rank, size);
+        local_y0 = block_of_rank[my_rank] / (GRID_WIDTH/local_edge_length) * local_edge_length;
+        local_x0 = block_of_rank[my_rank] % (GRID_WIDTH/local_edge_length) * local_edge_length;
+
+        /* Agree on the key of the random decisions */
+        random_seed = RANDOM_SEED? RANDOM_SEED : (uint32_t)time(NULL);
+        MPI_Bcast(&random_seed, 1, MPI_UINT32_T, 0, compute_comm);
+
+        /* Offsets of every processor's block in the distributed grid (for MPI_Scatterv/MPI_Gatherv) */
+        int *block_counts = malloc(sizeof(int) * size);
+        int *block_displs = malloc(sizeof(int) * size);
+        for (int i=0; i<size; i++) {
+                block_counts[i] = local_grid_size;
+                block_displs[i] = block_of_rank[i]*local_grid_size;
+        }
+
+        /* Proc 0 only holds the entire grid if it gathers it for drawing */
+        const int root_grid = FRAME_EVERY <= 0 && !DISTRIBUTE_DRAW && VIEWPORT_W <= 0 && !STREAM_SOCKET[0];
+
+        /* Initialise entire grid and communicate it to all processors */
+        int *grid = (my_rank || !root_grid)? NULL : calloc(TOTAL_GRID_SIZE, sizeof(int));
+        int start_gen = 0;
+        if (RESTART_FILE[0]) {
+                /* Continue from a checkpoint, every processor reads its own block */
+                start_gen = read_checkpoint(local_grid, local_edge_length);
+        } else if (BOARD_FILE[0]) {
+                /* Start from a board file, every processor unpacks its own tiles */
+                size_t length;
+                int tile;
+                const unsigned char *board = map_board(&length, &tile);
+                for (int y=0; y<local_edge_length; y++)
+                        unpack_board_row(board, tile, local_y0+y, local_x0, local_edge_length, &local_grid[y*local_edge_length]);
+                munmap((void *)board, length);
+        } else if (!root_grid) {
+                /* Without the entire grid on proc 0 every processor initialises its own block */
+                for (int y=0; y<local_edge_length; y++)
+                        for (int x=0; x<local_edge_length; x++)
+                                local_grid[y*local_edge_length+x] = start_cell(local_y0+y, local_x0+x);
+        } else if (!my_rank) {
+                /* Proc 0 initialises and distributes data (the same cells as above) */
+                for (int y=0; y<GRID_WIDTH; y++)
+                        for (int x=0; x<GRID_WIDTH; x++)
+                                grid[(long long)y*GRID_WIDTH+x] = start_cell(y, x);
+
+                /* Transform grid for easy distribution */
+                transform_for_distribution(grid, local_edge_length);
+        }
+
+        /* Distribute the entire grid across all processors */
+        if (root_grid && !RESTART_FILE[0] && !BOARD_FILE[0])
+                MPI_Scatterv(grid, block_counts, block_displs, MPI_INT, local_grid, local_grid_size, MPI_INT, 0, compute_comm);
+        /* Each processor does now have a part of the grid in local_grid */
+
+        fprintf(stdout, "[%d|%d] (%s): Local grid size = %dx%d\n", my_rank, size, processor_name, local_edge_length, local_edge_length);
+
+        /* Synchronize all processors */
+        MPI_Barrier(compute_comm);
+        if (!my_rank) {
+                fprintf(stdout, "\nReady to start? Press ENTER to continue.");
+                fflush(stdout);
+                getchar();
+                system("clear");
+        }
+
+        /* Determine all eight neighbour processors */
+        int neigh_procs[8] = {0};
+        get_neighbour_ids(neigh_procs, block_of_rank[my_rank], size);
+        for (int i=0; i<8; i++)
+                neigh_procs[i] = rank_of_block[neigh_procs[i]]; // Translate neighbour blocks to ranks
+
+        /* Prepare some values for the context from the other processes */
+        /* (zeroed, context values the neighbourhood does not need are never exchanged) */
+        int *my_ups = calloc(local_edge_length+2, sizeof(int)); // Rows include the two corners
+        int *my_lefts = calloc(local_edge_length, sizeof(int));
+        int *my_rights = calloc(local_edge_length, sizeof(int));
+        int *my_downs = calloc(local_edge_length+2, sizeof(int));
+
+        /* Local grid with a deep ghost ring and the type of its column blocks (if HALO_DEPTH > 1) */
+        const int deep_edge_length = local_edge_length+2*HALO_DEPTH;
+        int *deep_grid = (HALO_DEPTH > 1)? malloc(sizeof(int) * deep_edge_length*deep_edge_length) : NULL;
+        MPI_Datatype deep_col_type = MPI_DATATYPE_NULL;
+        if (HALO_DEPTH > 1) {
+                MPI_Type_vector(local_edge_length, HALO_DEPTH, deep_edge_length, MPI_INT, &deep_col_type);
+                MPI_Type_commit(&deep_col_type);
+        }
+
+        /* Delta stream with its index and the local grid of the last record (if DELTA_FILE is set) */
+        MPI_File delta_file;
+        FILE *delta_index = NULL;
+        MPI_Offset delta_end = 0;
+        int next_keyframe = 0;
+        int *prev_grid = DELTA_FILE[0]? calloc(local_grid_size, sizeof(int)) : NULL;
+
+        /* Drawn cells of the viewport (if VIEWPORT_W is set) */
+        int *view = malloc(sizeof(int) * VIEWPORT_PIXELS);
+
+        /* Snapshot of the local grid for checkpoints (in flight to an I/O processor until ckpt_req completes) */
+        int *ckpt_buf = (CHECKPOINT_EVERY > 0)? malloc(sizeof(int) * checkpoint_length(local_edge_length)) : NULL;
+        MPI_Request ckpt_req = MPI_REQUEST_NULL;
+        int *ckpt_base = (CHECKPOINT_EVERY > 0 && CHECKPOINT_FULL_EVERY > 1)? malloc(sizeof(int) * local_grid_size) : NULL; // Local grid at the last full checkpoint
+        int ckpt_base_gen = 0, n_checkpoints = 0;
+        if (DELTA_FILE[0]) {
+                MPI_File_open(compute_comm, DELTA_FILE, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &delta_file);
+                MPI_File_set_size(delta_file, 0);
+                if (!my_rank) {
+                        char name[256];
+                        snprintf(name, sizeof(name), "%s.idx", DELTA_FILE);
+                        delta_index = fopen(name, "wb");
+                        if (delta_index)
+                                fwrite("GOLINDEX", 1, 8, delta_index);
+                }
+        }
+
+        /* Game of Life - Loop */
+        for (int gen=start_gen; gen < N_GENERATIONS; gen+=HALO_DEPTH) {
+                /* Synchronize all processors (not for the viewport or stream, which the root processor may draw behind) */
+                if (VIEWPORT_W <= 0 && !STREAM_SOCKET[0])
+                        MPI_Barrier(compute_comm);
+
+                /* Record the changes (or all cells in a keyframe) */
+                if (DELTA_FILE[0]) {
+                        const int keyframe = gen >= next_keyframe;
+                        if (keyframe)
+                                next_keyframe = (KEYFRAME_EVERY > 0)? gen+KEYFRAME_EVERY : N_GENERATIONS;
+                        write_deltas(delta_file, delta_index, &delta_end, local_grid, prev_grid, local_edge_length, gen, keyframe);
+                }
+
+                /* Save a checkpoint (not of the generation the run started with) */
+                if (every(gen, CHECKPOINT_EVERY) && gen != start_gen) {
+                        /* The first checkpoint of a run is a full one */
+                        if (CHECKPOINT_FULL_EVERY <= 1 || every(n_checkpoints++, CHECKPOINT_FULL_EVERY))
+                                ckpt_base_gen = gen;
+                        checkpoint(ckpt_buf, &ckpt_req, local_grid, ckpt_base, ckpt_base_gen, local_edge_length, gen);
+                }
+
+                /* Draw the grid */
+                if (FRAME_EVERY > 0) {
+                        /* Write every FRAME_EVERY-th generation to a file instead */
+                        if (every(gen, FRAME_EVERY)) {
+                                write_frame(local_grid, local_edge_length, gen);
+                                /* Record the viewport (without the grid ever being gathered) */
+                                if (GIF_FILE[0]) {
+                                        gather_viewport(local_grid, local_edge_length, block_of_rank, view);
+                                        if (!my_rank)
+                                                write_gif_frame(view, VIEW_W, VIEW_H);
+                                }
+                        }
+                } else if (DISTRIBUTE_DRAW)
+                        /* Let each processor draw parts of the grid (for use on a raspberry pi cluster) */
+                        draw_local_grid(local_grid, local_edge_length);
+                else if (STREAM_SOCKET[0]) {
+                        /* Collect the cells without waiting, proc 0 drops the frame while the viewer lags behind */
+                        gather_viewport(local_grid, local_edge_length, block_of_rank, view);
+                        if (!my_rank && stream_ready())
+                                stream_frame(view, VIEW_W, VIEW_H, gen);
+                } else if (VIEWPORT_W > 0) {
+                        /* Only the processors in the viewport send their part to proc 0 */
+                        gather_viewport(local_grid, local_edge_length, block_of_rank, view);
+                        if (!my_rank) {
+                                draw_viewport(view, local_edge_length);
+                                fprintf(stdout, "Generation: %d|%d\n", gen, N_GENERATIONS-1);
+                                if (GIF_FILE[0])
+                                        write_gif_frame(view, VIEW_W, VIEW_H);
+                        }
+                } else {
+                        /* Gather all distributed fields so proc 0 can display everything */
+                        MPI_Gatherv(local_grid, local_grid_size, MPI_INT, grid, block_counts, block_displs, MPI_INT, 0, compute_comm);
+
+                        /* Processor 0 */
+                        if (!my_rank) {
                                 /* Transform distributed grid back into one grid */
                                 transform_from_distribution(grid, local_edge_length);
                                 /* Display grid */
                                 draw_grid(grid,local_edge_length);
                                 /* Print generation */
                                 fprintf(stdout, "Generation: %d|%d\n", gen, N_GENERATIONS-1);
+                                /* Record the grid */
+                                if (GIF_FILE[0])
+                                        write_gif_frame(grid, GRID_WIDTH, GRID_WIDTH);
                         }
                 }
 
-                /* Provide and collect all required contexts for/from the other processors */
-
-                /* Expose own corners */
-                MPI_Send(&local_grid[0], 1, MPI_INT, neigh_procs[0], TAG_DR, MPI_COMM_WORLD); // expose up-left
-                MPI_Send(&local_grid[local_edge_length-1], 1, MPI_INT, neigh_procs[2], TAG_DL, MPI_COMM_WORLD); // expose up-right
-                MPI_Send(&local_grid[local_grid_size-local_edge_length], 1, MPI_INT, neigh_procs[5], TAG_UR, MPI_COMM_WORLD); // expose lower left
-                MPI_Send(&local_grid[local_grid_size-1], 1, MPI_INT, neigh_procs[7], TAG_UL, MPI_COMM_WORLD); // expose lower right
+                if (MARGOLUS[0]) {
+                        /* Update the 2x2 blocks of this generation's partition */
+                        margolus_step(local_grid, local_edge_length, gen, neigh_procs);
+                } else if (HALO_DEPTH > 1) {
+                        /* Exchange a deep ghost ring and compute HALO_DEPTH generations at once */
+                        /* (the last pass only computes the generations that are left, with a thinner ring) */
+                        const int depth = (N_GENERATIONS-gen < HALO_DEPTH)? N_GENERATIONS-gen : HALO_DEPTH;
+                        if (depth < HALO_DEPTH) {
+                                MPI_Type_free(&deep_col_type);
+                                MPI_Type_vector(local_edge_length, depth, local_edge_length+2*depth, MPI_INT, &deep_col_type);
+                                MPI_Type_commit(&deep_col_type);
+                        }
+                        exchange_deep(local_grid, deep_grid, local_edge_length, depth, neigh_procs, deep_col_type);
+                        update_local_grid_tiled(local_grid, local_edge_length, depth, gen, deep_grid);
+                } else {
+                        /* Provide and collect all required contexts for/from the other processors */
+                        if (HALO_EXCHANGE)
+                                exchange_two_phase(local_grid, local_edge_length, neigh_procs, my_ups, my_downs, my_lefts, my_rights);
+                        else
+                                exchange_eight_way(local_grid, local_edge_length, neigh_procs, my_ups, my_downs, my_lefts, my_rights);
 
-                /* Get own borders */
-                for (int i=0; i<local_edge_length;i++) {
-                        my_ups[i] = local_grid[i];
-                        my_lefts[i] = local_grid[i*local_edge_length];
-                        my_rights[i] = local_grid[(i+1)*local_edge_length-1];
-                        my_downs[i] = local_grid[local_grid_size-local_edge_length+i];
+                        /* Update local grid */
+                        update_local_grid(local_grid, local_edge_length, gen,
+                                          my_ups[0], my_ups[local_edge_length+1], my_downs[0], my_downs[local_edge_length+1],
+                                          my_ups+1, my_downs+1, my_lefts, my_rights);
                 }
 
-                /* Expose own borders */
-                MPI_Send(my_ups, local_edge_length, MPI_INT, neigh_procs[1], TAG_DO, MPI_COMM_WORLD); // expose ups
-                MPI_Send(my_lefts, local_edge_length, MPI_INT, neigh_procs[3], TAG_RI, MPI_COMM_WORLD); // expose lefts
-                MPI_Send(my_rights, local_edge_length, MPI_INT, neigh_procs[4], TAG_LE, MPI_COMM_WORLD); // expose rights
-                MPI_Send(my_downs, local_edge_length, MPI_INT, neigh_procs[6], TAG_UP, MPI_COMM_WORLD); // expose downs
-
-                /* Collect adjacent corners */
-                MPI_Recv(&up_left, 1, MPI_INT, neigh_procs[0], TAG_UL, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive upper left
-                MPI_Recv(&up_right, 1, MPI_INT, neigh_procs[2], TAG_UR, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive upper right
-                MPI_Recv(&down_left, 1, MPI_INT, neigh_procs[5], TAG_DL, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive down left
-                MPI_Recv(&down_right, 1, MPI_INT, neigh_procs[7], TAG_DR, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive down right
-
-                /* Collect adjacent borders */
-                MPI_Recv(my_ups, local_edge_length, MPI_INT, neigh_procs[1], TAG_UP, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive ups
-                MPI_Recv(my_downs, local_edge_length, MPI_INT, neigh_procs[6], TAG_DO, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive downs
-                MPI_Recv(my_lefts, local_edge_length, MPI_INT, neigh_procs[3], TAG_LE, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive lefts
-                MPI_Recv(my_rights, local_edge_length, MPI_INT, neigh_procs[4], TAG_RI, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // receive rights
-
-                /* Update local grid */
-                update_local_grid(local_grid, local_edge_length, up_left, up_right, down_left, down_right, my_ups, my_downs, my_lefts, my_rights);
-
                 /* Generation delay */
                 usleep(GEN_DELAY_MS*1000);
         }
 
+        if (!my_rank) {
+                close_gif();
+                close_stream();
+        }
+        if (VIEW_GATHERED)
+                close_viewport();
+        if (BOARD_WRITE[0])
+                write_board(local_grid, local_edge_length);
+
+        /* Wait for the last checkpoint and release the I/O processors */
+        MPI_Wait(&ckpt_req, MPI_STATUS_IGNORE);
+        if (IO_RANKS > 0) {
+                const int done = -1;
+                MPI_Send(&done, 1, MPI_INT, io_processor(my_rank, size), TAG_CKPT, MPI_COMM_WORLD);
+        }
+        if (DELTA_FILE[0])
+                MPI_File_close(&delta_file);
+        if (delta_index)
+                fclose(delta_index);
+
         /* Free the pointers */
+        free(grid);
         free(local_grid);
         free(my_ups);
         free(my_lefts);
         free(my_rights);
         free(my_downs);
+        free(deep_grid);
+        free(prev_grid);
+        free(view);
+        free(ckpt_buf);
+        free(ckpt_base);
+        if (HALO_DEPTH > 1)
+                MPI_Type_free(&deep_col_type);
+        free(block_of_rank);
+        free(rank_of_block);
+        free(block_counts);
+        free(block_displs);
+        free(state_table);
 
         /* MPI Finalisation */
         MPI_Finalize();
@@ -338,160 +1495,1925 @@ int main(int argc, char** argv) {
         return 0;
 }
 
-void update_local_grid(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights) {
+int every(long long n, int k) {
+        return k > 0 && !(n % k);
+}
+
+void update_local_grid(int *g, int width, int gen, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights) {
+
+        /* The QuickLife and adaptive engines keep their own copy of the grid and do not need the context grid */
+        if (KERNEL == KERNEL_QUICKLIFE) {
+                quicklife_step(g, width, ul, ur, dl, dr, ups, downs, lefts, rights);
+                return;
+        }
+        if (KERNEL == KERNEL_ADAPTIVE) {
+                adaptive_step(g, width, ul, ur, dl, dr, ups, downs, lefts, rights);
+                return;
+        }
 
-        /* Prepare a copy of the local grid with an additional border for the context values */
-        int size = (width+2)*(width+2);
-        int *cg = malloc(sizeof(int) * size);
+        /* Prepare a copy of the local grid with an additional border for the context values.
+         * One spare (dead) row and column at the end lets kernels working on 2x2 cells overrun odd widths. */
+        int stride = width+3;
+        int *cg = calloc(stride*stride, sizeof(int));
 
         /* Fill the copy with local_grid and border values */
         for (int y=0; y<(width+2); y++) {
                 for (int x=0; x<(width+2); x++) {
+                        int v;
                         if (!x && !y)                                   // upper left corner
-                                cg[0] = ul;
+                                v = ul;
                         else if (!x && y==width+1)                      // lower left corner
-                                cg[size-(width+2)] = dl;
+                                v = dl;
                         else if (!x)                                    // left border
-                                cg[y*(width+2)] = lefts[y-1];
+                                v = lefts[y-1];
                         else if (!y && x==width+1)                      // upper right corner
-                                cg[width+1] = ur;
+                                v = ur;
                         else if (x==width+1 && y==width+1)              // lower right corner
-                                cg[size-1] = dr;
+                                v = dr;
                         else if (y==width+1)                            // lower border
-                                cg[size-(width+2)+x] = downs[x-1];
+                                v = downs[x-1];
                         else if (!y)                                    // upper border
-                                cg[x] = ups[x-1];
+                                v = ups[x-1];
                         else if (x==width+1)                            // right border
-                                cg[(y+1)*(width+2)-1] = rights[y-1];
+                                v = rights[y-1];
                         else                                            // (inside) - local_grid values
-                                cg[y*(width+2)+x] = g[(y-1)*width+(x-1)];
+                                v = g[(y-1)*width+(x-1)];
+                        cg[y*stride+x] = v;
                 }
         }
 
         /* Now update the grid */
-        for (int y=1; y<=width; y++) {
-                for (int x=1; x<=width; x++) {
-                        /* Create sum of the neighbours */
-                        int s = cg[(y-1)*(width+2)+x-1] + // up left
-                                cg[(y-1)*(width+2)+x] +   // up
-                                cg[(y-1)*(width+2)+x+1] + // up right
-                                cg[y*(width+2)+x-1] +     // left
-                                cg[y*(width+2)+x+1] +     // right
-                                cg[(y+1)*(width+2)+x-1] + // down left
-                                cg[(y+1)*(width+2)+x] +   // down
-                                cg[(y+1)*(width+2)+x+1];  // down right
-
-                        /* Game of Life rules */
-                        if ( s<2 || s>3 || (s==2 && !cg[y*(width+2)+x]))
-                                g[(y-1)*width+(x-1)] = 0; // Cell dies
-                        else
-                                g[(y-1)*width+(x-1)] = 1; // Cell lives
-                }
-        }
+        step_region(g, width, width, width, cg, stride, gen, local_y0, local_x0);
 
         /* Free the pointers */
         free(cg);
 }
 
 
-void transform_for_distribution(int grid[TOTAL_GRID_SIZE], int edge_length) {
-        /*
-              [ 0  1  2  3           box0     box1      box2         box3
-                4  5  6  7    >>> [0 1 4 5  2 3 6 7  8 9 12 13  10 11 14 15 ]
-                8  9 10 11
-               12 13 14 15 ]
+void update_local_grid_tiled(int *g, int width, int depth, int gen, const int *deep_grid) {
+        const int deep_stride = width+2*depth;
+        const int tile = (TEMPORAL_TILE > 0 && TEMPORAL_TILE < width)? TEMPORAL_TILE : width;
 
-                Goal: Prepare the normal grid (left) for easy equal distribution of subgrids (right) with MPI_Scatter.
-        */
+        /* Two buffers for a tile with its context rings plus a spare row and column (see step_region) */
+        const int stride = tile+2*depth+1;
+        int *cur = calloc(stride*stride, sizeof(int));
+        int *next = calloc(stride*stride, sizeof(int));
 
-        /* Create a copy of the grid */
-        int copy_grid[TOTAL_GRID_SIZE] = {0};
-        memcpy(copy_grid, grid, sizeof(int)*TOTAL_GRID_SIZE);
+        for (int ty=0; ty<width; ty+=tile) {
+                for (int tx=0; tx<width; tx+=tile) {
+                        const int th = (width-ty < tile)? width-ty : tile;
+                        const int tw = (width-tx < tile)? width-tx : tile;
 
-        /* Calculate the new indices for every element */
-        for (int i=0; i<TOTAL_GRID_SIZE; i++) {
-                int row = i/GRID_WIDTH;
-                int col = i%GRID_WIDTH;
-                int ng_row = row/edge_length;
-                int ng_col = col/edge_length;
+                        /* Copy the tile with all depth rings of context */
+                        for (int y=0; y<th+2*depth; y++)
+                                memcpy(&cur[y*stride], &deep_grid[(ty+y)*deep_stride+tx], sizeof(int)*(tw+2*depth));
 
-                /* Get the offset of the box */
-                int box_offset = edge_length*(ng_row*GRID_WIDTH + ng_col*edge_length);
+                        /* Advance all generations but the last, losing one ring of context each time */
+                        for (int k=1; k<depth; k++) {
+                                step_region(&next[k*stride+k], stride, tw+2*(depth-k), th+2*(depth-k), &cur[(k-1)*stride+(k-1)], stride,
+                                            gen+k-1, local_y0+ty+k-depth, local_x0+tx+k-depth);
+                                int *tmp = cur;
+                                cur = next;
+                                next = tmp;
+                        }
 
-                /* Get the offset inside the box */
-                int inbox_offset = edge_length*(row%edge_length)+(col%edge_length);
+                        /* The last generation is written straight into the local grid */
+                        step_region(&g[ty*width+tx], width, tw, th, &cur[(depth-1)*stride+(depth-1)], stride,
+                                    gen+depth-1, local_y0+ty, local_x0+tx);
+                }
+        }
 
-                grid[box_offset + inbox_offset] = copy_grid[i];
+        /* Free the pointers */
+        free(cur);
+        free(next);
+}
+
+void step_region(int *g, int gstride, int w, int h, const int *cg, int stride, int gen, int gy, int gx) {
+        switch (KERNEL) {
+                case KERNEL_LUT:
+                        step_lut(g, gstride, w, h, cg, stride);
+                        break;
+                case KERNEL_SEPARABLE:
+                        step_separable(g, gstride, w, h, cg, stride);
+                        break;
+                case KERNEL_TABLE:
+                        step_table(g, gstride, w, h, cg, stride);
+                        break;
+                default:
+                        step_naive(g, gstride, w, h, cg, stride);
+        }
+        if (!STOCHASTIC)
+                return;
+
+        /* Revert the changes that lose the draw (thresholds scaled to 2^32, so a probability of 1 always wins).
+         * Changes between two live states of a multi-state rule only depend on P_UPDATE. */
+        const uint64_t birth = (uint64_t)(P_UPDATE * P_BIRTH * 4294967296.0);
+        const uint64_t death = (uint64_t)(P_UPDATE * P_DEATH * 4294967296.0);
+        const uint64_t update = (uint64_t)(P_UPDATE * 4294967296.0);
+        for (int y=0; y<h; y++) {
+                /* Cells off the grid (ghost cells of a deep halo) draw with the index of the cell they mirror */
+                const uint64_t row = ((gy+y) % GRID_WIDTH + GRID_WIDTH) % GRID_WIDTH;
+                for (int x=0; x<w; x++) {
+                        const int old = cg[(y+1)*stride+x+1];
+                        if (g[y*gstride+x] == old)
+                                continue;
+                        const int col = ((gx+x) % GRID_WIDTH + GRID_WIDTH) % GRID_WIDTH;
+                        const uint64_t threshold = !old? birth : (!g[y*gstride+x]? death : update);
+                        if (philox_random(random_seed, RNG_STEP, gen, row*GRID_WIDTH+col) >= threshold)
+                                g[y*gstride+x] = old;
+                }
         }
 }
 
 
-void transform_from_distribution(int grid[TOTAL_GRID_SIZE], int edge_length) {
-        /*
-                                                             [ 0  1  4  5
-            box0     box1      box2         box3               2  3  6  7
-         [ 0 1 2 3  4 5 6 7  8 9 10 11  12 13 14 15 ]  >>>     8  9 12 13
-                                                              10 11 14 15 ]
+uint32_t philox_random(uint32_t seed, int stream, uint32_t gen, uint64_t cell) {
+        uint32_t c0 = gen, c1 = (uint32_t)cell, key = seed + ((uint32_t)(cell >> 32) << 1 | stream);
+        for (int i=0; i<10; i++) {
+                const uint64_t p = (uint64_t)0xD256D193 * c0;
+                c0 = (uint32_t)(p >> 32) ^ key ^ c1;
+                c1 = (uint32_t)p;
+                key += 0x9E3779B9; // Weyl sequence (golden ratio)
+        }
+        return c0;
+}
 
-                Goal: Merge the concatenated subgrids from MPI_Gather (left) to the normal grid (right).
-        */
+int start_cell(int gy, int gx) {
+        if (START_RANDOM)
+                return philox_random(random_seed, RNG_START, 0, (uint64_t)gy*GRID_WIDTH+gx) % n_states;
+        return GRID_WIDTH > 3 && ((gy == 1 && gx == 3) || (gy == 2 && (gx == 1 || gx == 3)) || (gy == 3 && (gx == 2 || gx == 3)));
+}
 
-        /* Create a copy of the grid */
-        int copy_grid[TOTAL_GRID_SIZE] = {0};
-        memcpy(copy_grid, grid, sizeof(int)*TOTAL_GRID_SIZE);
 
-        int box_size = edge_length*edge_length;
-        int boxes_per_row = GRID_WIDTH / edge_length;
+void step_naive(int *g, int gstride, int w, int h, const int *cg, int stride) {
+        for (int y=1; y<=h; y++) {
+                for (int x=1; x<=w; x++) {
+                        /* Create the index of the neighbourhood */
+                        int n = cg[(y-1)*stride+x-1] |      // up left
+                                cg[(y-1)*stride+x] << 1 |   // up
+                                cg[(y-1)*stride+x+1] << 2 | // up right
+                                cg[y*stride+x-1] << 3 |     // left
+                                cg[y*stride+x] << 4 |       // centre
+                                cg[y*stride+x+1] << 5 |     // right
+                                cg[(y+1)*stride+x-1] << 6 | // down left
+                                cg[(y+1)*stride+x] << 7 |   // down
+                                cg[(y+1)*stride+x+1] << 8;  // down right
+
+                        /* Apply the rule */
+                        g[(y-1)*gstride+(x-1)] = rule_table[n];
+                }
+        }
+}
+
+
+void step_lut(int *g, int gstride, int w, int h, const int *cg, int stride) {
+        /* Next states of the 2x2 centre cells for every 4x4 window (bit 3: upper left ... bit 0: lower right) */
+        static unsigned char lut[1<<16];
+        static int lut_ready = 0;
+
+        if (!lut_ready) {
+                for (int window=0; window<(1<<16); window++) {
+                        unsigned char next = 0;
+                        for (int cy=1; cy<=2; cy++) {
+                                for (int cx=1; cx<=2; cx++) {
+                                        /* Neighbourhood of the centre cell (cy,cx) inside the window */
+                                        int n = 0;
+                                        for (int dy=-1; dy<=1; dy++)
+                                                for (int dx=-1; dx<=1; dx++)
+                                                        n |= ((window >> (15-(cy+dy)*4-(cx+dx))) & 1) << ((dy+1)*3+dx+1);
+
+                                        /* Apply the rule */
+                                        if (rule_table[n])
+                                                next |= 1 << (3-(cy-1)*2-(cx-1));
+                                }
+                        }
+                        lut[window] = next;
+                }
+                lut_ready = 1;
+        }
+
+        for (int y=1; y<=h; y+=2) {
+                const int *r0 = &cg[(y-1)*stride], *r1 = r0+stride, *r2 = r1+stride, *r3 = r2+stride;
+
+                /* Preload the two leftmost columns of the window */
+                unsigned int w0 = r0[0]<<1 | r0[1], w1 = r1[0]<<1 | r1[1];
+                unsigned int w2 = r2[0]<<1 | r2[1], w3 = r3[0]<<1 | r3[1];
+
+                for (int x=1; x<=w; x+=2) {
+                        /* Shift in the next two columns */
+                        w0 = ((w0<<2) | r0[x+1]<<1 | r0[x+2]) & 0xF;
+                        w1 = ((w1<<2) | r1[x+1]<<1 | r1[x+2]) & 0xF;
+                        w2 = ((w2<<2) | r2[x+1]<<1 | r2[x+2]) & 0xF;
+                        w3 = ((w3<<2) | r3[x+1]<<1 | r3[x+2]) & 0xF;
+                        unsigned char next = lut[w0<<12 | w1<<8 | w2<<4 | w3];
+
+                        /* Write back the 2x2 block (clipped for odd sizes) */
+                        int *out = &g[(y-1)*gstride+(x-1)];
+                        out[0] = (next>>3) & 1;
+                        if (x<w)
+                                out[1] = (next>>2) & 1;
+                        if (y<h) {
+                                out[gstride] = (next>>1) & 1;
+                                if (x<w)
+                                        out[gstride+1] = next & 1;
+                        }
+                }
+        }
+}
+
+
+void step_separable(int *g, int gstride, int w, int h, const int *cg, int stride) {
+        /* Byte copy of the context grid and a row of column sums */
+        const int cw = w+2;
+        unsigned char *bg = malloc(cw*(h+2));
+        unsigned char *colsum = malloc(cw);
+
+        /* Next state by state and number of neighbours (totalistic rules only) */
+        unsigned char next[2][9];
+        for (int alive=0; alive<2; alive++) {
+                int n = alive << 4;
+                for (int k=0; k<9; k++) {
+                        next[alive][k] = rule_table[n];
+                        n |= 1 << (k<4 ? k : k+1); // Add one more neighbour (skipping the centre bit)
+                }
+        }
+
+        for (int y=0; y<h+2; y++)
+                for (int x=0; x<cw; x++)
+                        bg[y*cw+x] = (unsigned char)cg[y*stride+x];
+
+        for (int y=1; y<=h; y++) {
+                const unsigned char *up = &bg[(y-1)*cw], *mid = up+cw, *down = mid+cw;
+
+                /* Vertical sums of three cells for every column */
+                for (int x=0; x<cw; x++)
+                        colsum[x] = up[x] + mid[x] + down[x];
+
+                /* Slide the horizontal window over the column sums (the sum includes the cell itself) */
+                int *out = &g[(y-1)*gstride];
+                for (int x=1; x<=w; x++) {
+                        unsigned char s = colsum[x-1] + colsum[x] + colsum[x+1];
+
+                        /* Apply the rule */
+                        out[x-1] = next[mid[x]][s-mid[x]];
+                }
+        }
+
+        /* Free the pointers */
+        free(bg);
+        free(colsum);
+}
+
+
+void step_table(int *g, int gstride, int w, int h, const int *cg, int stride) {
+        /* Offsets of the digits of a state table index from the upper left cell of a neighbourhood */
+        int offset[9];
+        for (int j=0; j<table_cells; j++)
+                offset[j] = table_pos[j]/3*stride + table_pos[j]%3;
+
+        for (int y=0; y<h; y++) {
+                for (int x=0; x<w; x++) {
+                        const int *c = &cg[y*stride+x];
+                        int idx = 0;
+                        for (int j=table_cells-1; j>=0; j--)
+                                idx = idx*n_states + c[offset[j]];
+
+                        /* Apply the rule */
+                        g[y*gstride+x] = state_table[idx];
+                }
+        }
+}
+
+
+/* State of the QuickLife engine (see quicklife_step) */
+static struct {
+        int width;              // Length of one side of the local grid (0 = not initialised)
+        int words;              // 64 bit words per bit row (columns -1..width, bit x+1 holds column x)
+        uint64_t *cur, *next;   // Bit rows -1..width of the current and next generation
+        int blocks, groups;     // Blocks and groups per side
+        unsigned char *wake, *wake_next;        // Blocks to compute in this / the next generation
+        int *group_awake, *group_awake_next;    // Awake blocks per group
+} ql;
+
+/* Row y (-1..width) of a bit-packed generation */
+static uint64_t *ql_row(uint64_t *rows, int y) {
+        return &rows[(y+1)*ql.words];
+}
+
+/* Get n (<= 32) bits of a bit row starting at bit position p */
+static unsigned int ql_get_bits(const uint64_t *row, int p, int n) {
+        const int w = p>>6, o = p&63;
+        uint64_t v = row[w] >> o;
+        if (o > 64-n)
+                v |= row[w+1] << (64-o);
+        return (unsigned int)(v & ((1ull<<n)-1));
+}
+
+/* Set n (<= 32) bits of a bit row starting at bit position p */
+static void ql_set_bits(uint64_t *row, int p, int n, unsigned int bits) {
+        for (int i=0; i<n; i++) {
+                const uint64_t m = 1ull << ((p+i)&63);
+                if ((bits>>i) & 1)
+                        row[(p+i)>>6] |= m;
+                else
+                        row[(p+i)>>6] &= ~m;
+        }
+}
+
+/* Mark a block to be computed in the generation described by wake/group_awake */
+static void ql_wake_block(unsigned char *wake, int *group_awake, int by, int bx) {
+        if (by < 0 || bx < 0 || by >= ql.blocks || bx >= ql.blocks || wake[by*ql.blocks+bx])
+                return;
+        wake[by*ql.blocks+bx] = 1;
+        group_awake[(by/QL_GROUP)*ql.groups + bx/QL_GROUP]++;
+}
+
+/* Set a ghost cell in both generations and wake the blocks next to it if it changed */
+static void ql_set_ghost(int y, int x, int v) {
+        uint64_t *row = ql_row(ql.cur, y);
+        if ((int)((row[(x+1)>>6] >> ((x+1)&63)) & 1) == v)
+                return;
+        ql_set_bits(row, x+1, 1, v);
+        ql_set_bits(ql_row(ql.next, y), x+1, 1, v);
+
+        /* Wake the blocks of all real cells adjacent to the ghost cell */
+        for (int dy=-1; dy<=1; dy++)
+                for (int dx=-1; dx<=1; dx++)
+                        if (y+dy >= 0 && y+dy < ql.width && x+dx >= 0 && x+dx < ql.width)
+                                ql_wake_block(ql.wake, ql.group_awake, (y+dy)/QL_BLOCK, (x+dx)/QL_BLOCK);
+}
+
+/* Next state of the centre cells of a row from the rows above/below, each extended by one cell
+ * on both sides (bit i+1 holds cell i). Bit-sliced for up to 62 cells at once: the rule table is
+ * compiled into a reduced binary decision diagram over the nine cells of the neighbourhood that
+ * is evaluated with one bitwise multiplexer per node. */
+static uint64_t rule_row_bits(uint64_t above, uint64_t row, uint64_t below) {
+        /* Nodes in topological order (0 and 1 are the constants), built on first use */
+        static int n_nodes = 0, root;
+        static unsigned char var[1024];
+        static short lo[1024], hi[1024];
+
+        if (!n_nodes) {
+                /* Build the diagram bottom up over all 512 assignments, sharing equal nodes */
+                int node[10][512];
+                n_nodes = 2;
+                for (int v=9; v>=0; v--) {
+                        for (int a=0; a<(1<<v); a++) {
+                                if (v == 9) {
+                                        node[v][a] = rule_table[a];
+                                        continue;
+                                }
+                                const int l = node[v+1][a], h = node[v+1][a | 1<<v];
+                                int id = l;
+                                if (l != h) {
+                                        for (id=2; id<n_nodes; id++)
+                                                if (var[id] == v && lo[id] == l && hi[id] == h)
+                                                        break;
+                                        if (id == n_nodes) {
+                                                var[id] = v;
+                                                lo[id] = l;
+                                                hi[id] = h;
+                                                n_nodes++;
+                                        }
+                                }
+                                node[v][a] = id;
+                        }
+                }
+                root = node[0][0];
+        }
+
+        /* The nine cells of the neighbourhood of every centre cell (bit 4 is the centre) */
+        const uint64_t in[9] = {above, above>>1, above>>2, row, row>>1, row>>2, below, below>>1, below>>2};
+        uint64_t val[1024];
+        val[0] = 0;
+        val[1] = ~(uint64_t)0;
+        for (int i=2; i<n_nodes; i++)
+                val[i] = (in[var[i]] & val[hi[i]]) | (~in[var[i]] & val[lo[i]]);
+        return val[root];
+}
+
+void quicklife_step(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights) {
+
+        /* Create the bit-packed copy of the local grid with all blocks awake */
+        if (ql.width != width) {
+                ql.width = width;
+                ql.words = (width+2+QL_BLOCK+63)/64 + 1; // Room for reading a full block beyond the ghost column
+                ql.blocks = (width+QL_BLOCK-1)/QL_BLOCK;
+                ql.groups = (ql.blocks+QL_GROUP-1)/QL_GROUP;
+                ql.cur = calloc((width+2)*ql.words, sizeof(uint64_t));
+                ql.next = calloc((width+2)*ql.words, sizeof(uint64_t));
+                ql.wake = calloc(ql.blocks*ql.blocks, 1);
+                ql.wake_next = calloc(ql.blocks*ql.blocks, 1);
+                ql.group_awake = calloc(ql.groups*ql.groups, sizeof(int));
+                ql.group_awake_next = calloc(ql.groups*ql.groups, sizeof(int));
+                for (int y=0; y<width; y++)
+                        for (int x=0; x<width; x++)
+                                if (g[y*width+x]) {
+                                        ql_set_bits(ql_row(ql.cur, y), x+1, 1, 1);
+                                        ql_set_bits(ql_row(ql.next, y), x+1, 1, 1);
+                                }
+                for (int by=0; by<ql.blocks; by++)
+                        for (int bx=0; bx<ql.blocks; bx++)
+                                ql_wake_block(ql.wake, ql.group_awake, by, bx);
+        }
+
+        /* Copy the ghost ring, waking the border blocks next to changed ghost cells */
+        ql_set_ghost(-1, -1, ul);
+        ql_set_ghost(-1, width, ur);
+        ql_set_ghost(width, -1, dl);
+        ql_set_ghost(width, width, dr);
+        for (int i=0; i<width; i++) {
+                ql_set_ghost(-1, i, ups[i]);
+                ql_set_ghost(width, i, downs[i]);
+                ql_set_ghost(i, -1, lefts[i]);
+                ql_set_ghost(i, width, rights[i]);
+        }
+
+        /* Compute all awake blocks of all groups that are not asleep */
+        for (int gy=0; gy<ql.groups; gy++) {
+                for (int gx=0; gx<ql.groups; gx++) {
+                        if (!ql.group_awake[gy*ql.groups+gx])
+                                continue;
+                        ql.group_awake[gy*ql.groups+gx] = 0;
+
+                        for (int by=gy*QL_GROUP; by<(gy+1)*QL_GROUP && by<ql.blocks; by++) {
+                                for (int bx=gx*QL_GROUP; bx<(gx+1)*QL_GROUP && bx<ql.blocks; bx++) {
+                                        if (!ql.wake[by*ql.blocks+bx])
+                                                continue;
+                                        ql.wake[by*ql.blocks+bx] = 0;
+
+                                        /* Update the rows of the block (clipped at the edge of the local grid) */
+                                        const int x0 = bx*QL_BLOCK;
+                                        const int n = (width-x0 < QL_BLOCK)? width-x0 : QL_BLOCK;
+                                        int changed = 0;
+                                        for (int y=by*QL_BLOCK; y<(by+1)*QL_BLOCK && y<width; y++) {
+                                                const unsigned int old = ql_get_bits(ql_row(ql.cur, y), x0+1, n);
+                                                const unsigned int next = rule_row_bits(ql_get_bits(ql_row(ql.cur, y-1), x0, QL_BLOCK+2),
+                                                                                        ql_get_bits(ql_row(ql.cur, y), x0, QL_BLOCK+2),
+                                                                                        ql_get_bits(ql_row(ql.cur, y+1), x0, QL_BLOCK+2)) & ((1u<<n)-1);
+                                                ql_set_bits(ql_row(ql.next, y), x0+1, n, next);
+                                                if (next != old) {
+                                                        changed = 1;
+                                                        for (int i=0; i<n; i++)
+                                                                g[y*width+x0+i] = (next>>i) & 1;
+                                                }
+                                        }
+
+                                        /* A changed block keeps itself and its neighbours awake */
+                                        if (changed)
+                                                for (int dy=-1; dy<=1; dy++)
+                                                        for (int dx=-1; dx<=1; dx++)
+                                                                ql_wake_block(ql.wake_next, ql.group_awake_next, by+dy, bx+dx);
+                                }
+                        }
+                }
+        }
+
+        /* Swap the generations and the wake flags */
+        uint64_t *rows = ql.cur;
+        ql.cur = ql.next;
+        ql.next = rows;
+        unsigned char *wake = ql.wake;
+        ql.wake = ql.wake_next;
+        ql.wake_next = wake;
+        int *group_awake = ql.group_awake;
+        ql.group_awake = ql.group_awake_next;
+        ql.group_awake_next = group_awake;
+}
+
+/* A tile of the adaptive engine (see adaptive_step) */
+typedef struct {
+        int dense;              // 1: rows holds the cells, 0: cells holds the live cells
+        uint32_t *rows;         // Bit rows of a dense tile (bit x holds column x)
+        unsigned short *cells;  // Live cells (y*AT_TILE+x) of a sparse tile
+        int count, capacity;    // Number of live cells / entries allocated in cells
+        uint32_t top, bottom, left, right;      // Cells on the four edges of the tile
+} at_tile;
+
+/* State of the adaptive engine */
+static struct {
+        int width;              // Length of one side of the local grid (0 = not initialised)
+        int tiles;              // Tiles per side
+        at_tile *cur, *next;    // Tiles of the current and next generation
+        int ul, ur, dl, dr;     // Ghost ring of the current generation
+        int *ups, *downs, *lefts, *rights;
+        unsigned char *marked, *alive;  // Scratch of the sparse kernel (one entry per cell of a tile)
+        unsigned short *touched;        // Marked cells of the sparse kernel
+} at;
+
+/* Height/width of a tile (the last row/column of tiles may be smaller) */
+static int at_extent(int t) {
+        return (at.width - t*AT_TILE < AT_TILE)? at.width - t*AT_TILE : AT_TILE;
+}
+
+/* Append a live cell to a sparse tile */
+static void at_add_cell(at_tile *t, int idx) {
+        if (t->count == t->capacity) {
+                t->capacity = t->capacity? 2*t->capacity : 16;
+                t->cells = realloc(t->cells, sizeof(unsigned short) * t->capacity);
+        }
+        t->cells[t->count++] = idx;
+}
+
+/* Update the edge cells of a tile */
+static void at_compute_edges(at_tile *t, int th, int tw) {
+        t->top = t->bottom = t->left = t->right = 0;
+        if (t->dense) {
+                t->top = t->rows[0];
+                t->bottom = t->rows[th-1];
+                for (int y=0; y<th; y++) {
+                        t->left |= (t->rows[y] & 1) << y;
+                        t->right |= ((t->rows[y] >> (tw-1)) & 1) << y;
+                }
+        } else {
+                for (int i=0; i<t->count; i++) {
+                        const int y = t->cells[i]/AT_TILE, x = t->cells[i]%AT_TILE;
+                        if (!y) t->top |= 1u << x;
+                        if (y == th-1) t->bottom |= 1u << x;
+                        if (!x) t->left |= 1u << y;
+                        if (x == tw-1) t->right |= 1u << y;
+                }
+        }
+}
+
+/* Switch a tile to the bitmap representation */
+static void at_make_dense(at_tile *t, int th) {
+        if (!t->rows)
+                t->rows = malloc(sizeof(uint32_t) * AT_TILE);
+        memset(t->rows, 0, sizeof(uint32_t) * th);
+        for (int i=0; i<t->count; i++)
+                t->rows[t->cells[i]/AT_TILE] |= 1u << (t->cells[i]%AT_TILE);
+        free(t->cells);
+        t->cells = NULL;
+        t->count = t->capacity = 0;
+        t->dense = 1;
+}
+
+/* Switch a tile to the live cell list representation */
+static void at_make_sparse(at_tile *t, int th, int tw) {
+        t->count = 0;
+        for (int y=0; y<th; y++)
+                for (int x=0; x<tw; x++)
+                        if ((t->rows[y] >> x) & 1)
+                                at_add_cell(t, y*AT_TILE+x);
+        free(t->rows);
+        t->rows = NULL;
+        t->dense = 0;
+}
+
+/* State of any cell on a tile edge or in the ghost ring of the current generation */
+static int at_cell(int y, int x) {
+        const int w = at.width;
+        if (y < 0)
+                return (x < 0)? at.ul : ((x >= w)? at.ur : at.ups[x]);
+        if (y >= w)
+                return (x < 0)? at.dl : ((x >= w)? at.dr : at.downs[x]);
+        if (x < 0)
+                return at.lefts[y];
+        if (x >= w)
+                return at.rights[y];
+
+        const at_tile *t = &at.cur[(y/AT_TILE)*at.tiles + x/AT_TILE];
+        const int ty = y%AT_TILE, tx = x%AT_TILE;
+        if (!ty)
+                return (t->top >> tx) & 1;
+        if (ty == at_extent(y/AT_TILE)-1)
+                return (t->bottom >> tx) & 1;
+        if (!tx)
+                return (t->left >> ty) & 1;
+        return (t->right >> ty) & 1; // Only edge cells are ever requested
+}
+
+/* Cells of the ghost ring adjacent to one side of a tile as bits */
+static uint32_t at_ghost_bits(const int *values, int offset, int n) {
+        uint32_t bits = 0;
+        for (int i=0; i<n; i++)
+                bits |= (uint32_t)(values[offset+i] & 1) << i;
+        return bits;
+}
+
+/* Advance a dense tile (bit-sliced) and write changed rows back to g */
+static void at_step_dense(const at_tile *t, at_tile *n, int ty, int tx, int th, int tw,
+                          uint32_t above, uint32_t below, uint32_t left, uint32_t right, int *g) {
+        const int y0 = ty*AT_TILE, x0 = tx*AT_TILE;
+        const uint32_t mask = (tw == 32)? 0xFFFFFFFFu : (1u<<tw)-1;
+
+        if (!n->rows)
+                n->rows = malloc(sizeof(uint32_t) * AT_TILE);
+        n->dense = 1;
+        n->count = 0;
+
+        /* Rows extended by the cells left and right of the tile (bit x+1 holds column x) */
+        uint64_t prev = (uint64_t)above<<1 | at_cell(y0-1, x0-1) | (uint64_t)at_cell(y0-1, x0+tw)<<(tw+1);
+        uint64_t row = (uint64_t)t->rows[0]<<1 | (left & 1) | (uint64_t)(right & 1)<<(tw+1);
+        for (int y=0; y<th; y++) {
+                const uint64_t following = (y+1 < th)?
+                        (uint64_t)t->rows[y+1]<<1 | ((left>>(y+1)) & 1) | (uint64_t)((right>>(y+1)) & 1)<<(tw+1) :
+                        (uint64_t)below<<1 | at_cell(y0+th, x0-1) | (uint64_t)at_cell(y0+th, x0+tw)<<(tw+1);
+                n->rows[y] = (uint32_t)rule_row_bits(prev, row, following) & mask;
+                n->count += __builtin_popcount(n->rows[y]);
+
+                /* Write back changed rows */
+                if (n->rows[y] != t->rows[y])
+                        for (int x=0; x<tw; x++)
+                                g[(y0+y)*at.width+x0+x] = (n->rows[y] >> x) & 1;
+                prev = row;
+                row = following;
+        }
+}
+
+/* Mark a cell of the tile as candidate for the next generation (if it lies inside) */
+static void at_touch(int th, int tw, int y, int x, int *n_touched) {
+        if (y < 0 || x < 0 || y >= th || x >= tw)
+                return;
+        const int idx = y*AT_TILE+x;
+        if (!at.marked[idx]) {
+                at.marked[idx] = 1;
+                at.touched[(*n_touched)++] = idx;
+        }
+}
+
+/* Advance a sparse tile by evaluating the cells next to live cells only and write the changes back to g */
+static void at_step_sparse(const at_tile *t, at_tile *n, int ty, int tx, int th, int tw,
+                           uint32_t above, uint32_t below, uint32_t left, uint32_t right, int *g) {
+        const int y0 = ty*AT_TILE, x0 = tx*AT_TILE;
+        const int c_ul = at_cell(y0-1, x0-1), c_ur = at_cell(y0-1, x0+tw);
+        const int c_dl = at_cell(y0+th, x0-1), c_dr = at_cell(y0+th, x0+tw);
+
+        free(n->rows);
+        n->rows = NULL;
+        n->dense = 0;
+        n->count = 0;
+
+        /* Nothing can happen in an empty tile without live cells around it (B0 rules are excluded) */
+        if (!t->count && !above && !below && !left && !right && !c_ul && !c_ur && !c_dl && !c_dr)
+                return;
+
+        /* Mark the live cells and all cells next to them */
+        int n_touched = 0;
+        for (int i=0; i<t->count; i++) {
+                const int y = t->cells[i]/AT_TILE, x = t->cells[i]%AT_TILE;
+                at.alive[t->cells[i]] = 1;
+                for (int dy=-1; dy<=1; dy++)
+                        for (int dx=-1; dx<=1; dx++)
+                                at_touch(th, tw, y+dy, x+dx, &n_touched);
+        }
+
+        /* Add the cells next to live cells around the tile */
+        for (int i=0; i<32; i++) {
+                for (int d=-1; d<=1; d++) {
+                        if ((above >> i) & 1)
+                                at_touch(th, tw, 0, i+d, &n_touched);
+                        if ((below >> i) & 1)
+                                at_touch(th, tw, th-1, i+d, &n_touched);
+                        if ((left >> i) & 1)
+                                at_touch(th, tw, i+d, 0, &n_touched);
+                        if ((right >> i) & 1)
+                                at_touch(th, tw, i+d, tw-1, &n_touched);
+                }
+        }
+        if (c_ul) at_touch(th, tw, 0, 0, &n_touched);
+        if (c_ur) at_touch(th, tw, 0, tw-1, &n_touched);
+        if (c_dl) at_touch(th, tw, th-1, 0, &n_touched);
+        if (c_dr) at_touch(th, tw, th-1, tw-1, &n_touched);
+
+        /* Look up the neighbourhood of every marked cell in the rule table */
+        for (int i=0; i<n_touched; i++) {
+                const int idx = at.touched[i];
+                const int y = idx/AT_TILE, x = idx%AT_TILE;
+                int nb = 0;
+                for (int dy=-1; dy<=1; dy++) {
+                        for (int dx=-1; dx<=1; dx++) {
+                                const int inside = y+dy >= 0 && x+dx >= 0 && y+dy < th && x+dx < tw;
+                                const int v = inside? at.alive[idx+dy*AT_TILE+dx] : at_cell(y0+y+dy, x0+x+dx);
+                                nb |= v << ((dy+1)*3+dx+1);
+                        }
+                }
+                if (rule_table[nb])
+                        at_add_cell(n, idx);
+                at.marked[idx] = 0;
+        }
+
+        /* Write back: clear the old live cells, then set the new ones */
+        for (int i=0; i<t->count; i++) {
+                at.alive[t->cells[i]] = 0;
+                g[(y0 + t->cells[i]/AT_TILE)*at.width + x0 + t->cells[i]%AT_TILE] = 0;
+        }
+        for (int i=0; i<n->count; i++)
+                g[(y0 + n->cells[i]/AT_TILE)*at.width + x0 + n->cells[i]%AT_TILE] = 1;
+}
+
+void adaptive_step(int *g, int width, int ul, int ur, int dl, int dr, int *ups, int *downs, int *lefts, int *rights) {
+
+        /* Create the tiles from the local grid */
+        if (at.width != width) {
+                at.width = width;
+                at.tiles = (width+AT_TILE-1)/AT_TILE;
+                at.cur = calloc(at.tiles*at.tiles, sizeof(at_tile));
+                at.next = calloc(at.tiles*at.tiles, sizeof(at_tile));
+                at.marked = calloc(AT_TILE*AT_TILE, 1);
+                at.alive = calloc(AT_TILE*AT_TILE, 1);
+                at.touched = malloc(sizeof(unsigned short) * AT_TILE*AT_TILE);
+                for (int ty=0; ty<at.tiles; ty++) {
+                        for (int tx=0; tx<at.tiles; tx++) {
+                                at_tile *t = &at.cur[ty*at.tiles+tx];
+                                const int th = at_extent(ty), tw = at_extent(tx);
+                                for (int y=0; y<th; y++)
+                                        for (int x=0; x<tw; x++)
+                                                if (g[(ty*AT_TILE+y)*width + tx*AT_TILE+x])
+                                                        at_add_cell(t, y*AT_TILE+x);
+                                if (t->count*AT_DENSE_DIV > th*tw)
+                                        at_make_dense(t, th);
+                                at_compute_edges(t, th, tw);
+                        }
+                }
+        }
+
+        /* Remember the ghost ring of this generation */
+        at.ul = ul; at.ur = ur; at.dl = dl; at.dr = dr;
+        at.ups = ups; at.downs = downs; at.lefts = lefts; at.rights = rights;
+
+        for (int ty=0; ty<at.tiles; ty++) {
+                for (int tx=0; tx<at.tiles; tx++) {
+                        const at_tile *t = &at.cur[ty*at.tiles+tx];
+                        at_tile *n = &at.next[ty*at.tiles+tx];
+                        const int th = at_extent(ty), tw = at_extent(tx);
+
+                        /* Edge cells of the adjacent tiles (or of the ghost ring) */
+                        const uint32_t above = ty? at.cur[(ty-1)*at.tiles+tx].bottom : at_ghost_bits(ups, tx*AT_TILE, tw);
+                        const uint32_t below = (ty < at.tiles-1)? at.cur[(ty+1)*at.tiles+tx].top : at_ghost_bits(downs, tx*AT_TILE, tw);
+                        const uint32_t left = tx? at.cur[ty*at.tiles+tx-1].right : at_ghost_bits(lefts, ty*AT_TILE, th);
+                        const uint32_t right = (tx < at.tiles-1)? at.cur[ty*at.tiles+tx+1].left : at_ghost_bits(rights, ty*AT_TILE, th);
+
+                        /* Advance the tile in its current representation */
+                        if (t->dense)
+                                at_step_dense(t, n, ty, tx, th, tw, above, below, left, right, g);
+                        else
+                                at_step_sparse(t, n, ty, tx, th, tw, above, below, left, right, g);
+
+                        /* Switch the representation if the population crossed a threshold */
+                        if (n->dense && n->count*AT_SPARSE_DIV < th*tw)
+                                at_make_sparse(n, th, tw);
+                        else if (!n->dense && n->count*AT_DENSE_DIV > th*tw)
+                                at_make_dense(n, th);
+                        at_compute_edges(n, th, tw);
+                }
+        }
+
+        /* Swap the generations */
+        at_tile *tiles = at.cur;
+        at.cur = at.next;
+        at.next = tiles;
+}
+
+void transform_for_distribution(int grid[TOTAL_GRID_SIZE], int edge_length) {
+        /*
+              [ 0  1  2  3           box0     box1      box2         box3
+                4  5  6  7    >>> [0 1 4 5  2 3 6 7  8 9 12 13  10 11 14 15 ]
+                8  9 10 11
+               12 13 14 15 ]
+
+                Goal: Prepare the normal grid (left) for easy equal distribution of subgrids (right) with MPI_Scatter.
+        */
+
+        /* Create a copy of the grid (on the heap, it may be far larger than the stack) */
+        int *copy_grid = malloc(sizeof(int)*TOTAL_GRID_SIZE);
+        memcpy(copy_grid, grid, sizeof(int)*TOTAL_GRID_SIZE);
+
+        /* Calculate the new indices for every element */
+        for (long long i=0; i<TOTAL_GRID_SIZE; i++) {
+                int row = i/GRID_WIDTH;
+                int col = i%GRID_WIDTH;
+                int ng_row = row/edge_length;
+                int ng_col = col/edge_length;
+
+                /* Get the offset of the box */
+                long long box_offset = (long long)edge_length*(ng_row*(long long)GRID_WIDTH + ng_col*edge_length);
+
+                /* Get the offset inside the box */
+                int inbox_offset = edge_length*(row%edge_length)+(col%edge_length);
+
+                grid[box_offset + inbox_offset] = copy_grid[i];
+        }
+
+        free(copy_grid);
+}
+
+
+void transform_from_distribution(int grid[TOTAL_GRID_SIZE], int edge_length) {
+        /*
+                                                             [ 0  1  4  5
+            box0     box1      box2         box3               2  3  6  7
+         [ 0 1 2 3  4 5 6 7  8 9 10 11  12 13 14 15 ]  >>>     8  9 12 13
+                                                              10 11 14 15 ]
+
+                Goal: Merge the concatenated subgrids from MPI_Gather (left) to the normal grid (right).
+        */
+
+        /* Create a copy of the grid (on the heap, it may be far larger than the stack) */
+        int *copy_grid = malloc(sizeof(int)*TOTAL_GRID_SIZE);
+        memcpy(copy_grid, grid, sizeof(int)*TOTAL_GRID_SIZE);
+
+        int box_size = edge_length*edge_length;
+        int boxes_per_row = GRID_WIDTH / edge_length;
 
         /* Calculate the original position of each cell in the grid */
-        for (int i=0; i<TOTAL_GRID_SIZE; i++) {
+        for (long long i=0; i<TOTAL_GRID_SIZE; i++) {
                 int box_index = i / box_size; // Get the index of the box
                 int box_col = box_index % boxes_per_row; // Determine row and column of that box in the grid
                 int box_row = box_index / boxes_per_row;
 
-                int inbox_offset = i % box_size; // Get the offset (row and col) inside the box
-                int inbox_col = inbox_offset % edge_length;
-                int inbox_row = inbox_offset / edge_length;
+                int inbox_offset = i % box_size; // Get the offset (row and col) inside the box
+                int inbox_col = inbox_offset % edge_length;
+                int inbox_row = inbox_offset / edge_length;
+
+                // Combine the box and inbox offsets to calculate original index
+                int new_col = box_col * edge_length + inbox_col;
+                long long new_row = (box_row * edge_length + inbox_row) * (long long)GRID_WIDTH;
+
+                grid[new_row + new_col] = copy_grid[i];
+        }
+
+        free(copy_grid);
+}
+
+/* Background color of a drawn cell: its state, or the color of its block (or white) if it is dead */
+static const char *cell_color(int v, int x, int y, int edge_length) {
+        /* States from 2 on (multi-state rule files) get the colors of ARR_COLORS */
+        if (v > 1)
+                return ARR_COLORS[(v-2)%NUM_COLORS];
+        if (v)
+                return C_B_BLACK;
+        if (COLOR_SUB_GRIDS) {
+                /* Get corresponding processor index for this pixel */
+                int pi = ((int)(y/edge_length))*(GRID_WIDTH/edge_length)+((int)(x/edge_length));
+                return ARR_COLORS[pi%NUM_COLORS];
+        }
+        return C_B_WHITE;
+}
+
+/* Append the foreground version of a background color ("\033[0;4Xm" or "\033[48;5;Nm") */
+static int put_foreground(char *p, const char *bg) {
+        if (!strncmp(bg, "\033[48;", 5))
+                return sprintf(p, "\033[38;%s", bg+5);
+        return sprintf(p, "\033[3%s", bg+5);
+}
+
+/* Draw w x h cells; cell (x, y) shows the zoom x zoom cells from column x0+x*zoom and row y0+y*zoom */
+static void draw_cells(const int *cells, int w, int h, int x0, int y0, int zoom, int edge_length) {
+        /* Dot of each cell of a 2x4 Braille pattern (U+2800 + dots) */
+        static const int braille_dot[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+        /* Build the frame in one buffer and write it at once (at most 32 bytes per character) */
+        char *frame = malloc((size_t)w*h*32 + h + 64), *p = frame;
+        p += sprintf(p, S_TOPLEFT);
+        if (RENDERER == RENDER_BRAILLE) {
+                for (int y=0; y<h; y+=4) {
+                        for (int x=0; x<w; x+=2) {
+                                int dots = 0;
+                                for (int dy=0; dy<4 && y+dy<h; dy++)
+                                        for (int dx=0; dx<2 && x+dx<w; dx++)
+                                                if (cells[(long long)(y+dy)*w+x+dx])
+                                                        dots |= braille_dot[dy][dx];
+                                *p++ = 0xE2; // UTF-8 of U+2800 + dots
+                                *p++ = 0xA0 | dots >> 6;
+                                *p++ = 0x80 | (dots & 0x3F);
+                        }
+                        *p++ = '\n';
+                }
+        } else if (RENDERER == RENDER_HALF) {
+                for (int y=0; y<h; y+=2) {
+                        for (int x=0; x<w; x++) {
+                                /* Upper half block in the color of the upper cell on the color of the lower one */
+                                const char *upper = cell_color(cells[(long long)y*w+x], x0+x*zoom, y0+y*zoom, edge_length);
+                                const char *lower = (y+1 < h)? cell_color(cells[(long long)(y+1)*w+x], x0+x*zoom, y0+(y+1)*zoom, edge_length) : C_RST;
+                                p += sprintf(p, "%s", lower);
+                                p += put_foreground(p, upper);
+                                p += sprintf(p, "\xE2\x96\x80"); // U+2580
+                        }
+                        p += sprintf(p, "%s\n", C_RST);
+                }
+        } else {
+                for (int y=0; y<h; y++){
+                        for(int x=0; x<w; x++) {
+                                const int v = cells[(long long)y*w+x];
+                                const char *dead = cell_color(0, x0+x*zoom, y0+y*zoom, edge_length);
+                                p += sprintf(p, "%s  %s", v ? cell_color(v, x0+x*zoom, y0+y*zoom, edge_length) : dead, dead);
+                        }
+                        *p++ = '\n';
+                }
+        }
+        p += sprintf(p, C_RST);
+        fwrite(frame, 1, p-frame, stdout);
+        fflush(stdout);
+
+        /* Free the pointers */
+        free(frame);
+}
+
+void draw_grid(int grid[TOTAL_GRID_SIZE], int edge_length) {
+        draw_cells(grid, GRID_WIDTH, GRID_WIDTH, 0, 0, 1, edge_length);
+}
+
+void draw_viewport(const int *view, int edge_length) {
+        draw_cells(view, VIEW_W, VIEW_H, VIEW_X, VIEW_Y, VIEWPORT_ZOOM, edge_length);
+}
+
+/* Rectangle of drawn viewport cells (x, y, w, h) that a block touches. Returns 0 if it misses the viewport. */
+static int viewport_part(int block_y0, int block_x0, int edge_length, int part[4]) {
+        const int x0 = (block_x0 > VIEW_X)? block_x0 : VIEW_X;
+        const int y0 = (block_y0 > VIEW_Y)? block_y0 : VIEW_Y;
+        const int x1 = (block_x0+edge_length < VIEW_X+VIEW_CELLS_W)? block_x0+edge_length : VIEW_X+VIEW_CELLS_W;
+        const int y1 = (block_y0+edge_length < VIEW_Y+VIEW_CELLS_H)? block_y0+edge_length : VIEW_Y+VIEW_CELLS_H;
+        if (x0 >= x1 || y0 >= y1)
+                return 0;
+        part[0] = (x0-VIEW_X)/VIEWPORT_ZOOM;
+        part[1] = (y0-VIEW_Y)/VIEWPORT_ZOOM;
+        part[2] = (x1-1-VIEW_X)/VIEWPORT_ZOOM + 1 - part[0];
+        part[3] = (y1-1-VIEW_Y)/VIEWPORT_ZOOM + 1 - part[1];
+        return 1;
+}
+
+/* Part of the viewport in flight to the root processor (see gather_viewport) */
+static struct {
+        int *cells;             // Drawn cells of the own block (NULL if it misses the viewport)
+        MPI_Request req;        // Send of the last part (MPI_REQUEST_NULL if none)
+} vp = {NULL, MPI_REQUEST_NULL};
+
+void gather_viewport(const int *local_grid, int edge_length, const int *block_of_rank, int *view) {
+        int rank, size;
+        MPI_Comm_rank(compute_comm, &rank);
+        MPI_Comm_size(compute_comm, &size);
+        const int blocks = GRID_WIDTH/edge_length;
+
+        /* Reduce the own part to drawn cells (once the previous part has left the buffer) */
+        int part[4];
+        int *cells = NULL;
+        if (viewport_part(local_y0, local_x0, edge_length, part)) {
+                MPI_Wait(&vp.req, MPI_STATUS_IGNORE);
+                if (!vp.cells)
+                        vp.cells = malloc(sizeof(int) * part[2]*part[3]);
+                cells = vp.cells;
+                memset(cells, 0, sizeof(int) * part[2]*part[3]);
+                for (int y=0; y<edge_length; y++) {
+                        const int vy = local_y0+y-VIEW_Y;
+                        if (vy < 0 || vy >= VIEW_CELLS_H)
+                                continue;
+                        for (int x=0; x<edge_length; x++) {
+                                const int vx = local_x0+x-VIEW_X;
+                                if (vx < 0 || vx >= VIEW_CELLS_W)
+                                        continue;
+                                int *c = &cells[(vy/VIEWPORT_ZOOM-part[1])*part[2] + vx/VIEWPORT_ZOOM-part[0]];
+                                if (local_grid[y*edge_length+x] > *c)
+                                        *c = local_grid[y*edge_length+x];
+                        }
+                }
+                if (rank)
+                        MPI_Isend(cells, part[2]*part[3], MPI_INT, 0, TAG_VIEW, compute_comm, &vp.req);
+        }
+        if (rank)
+                return;
+
+        /* Proc 0 merges the parts of all processors in the viewport (including its own) */
+        memset(view, 0, sizeof(int) * VIEW_W*VIEW_H);
+        int *buf = malloc(sizeof(int) * VIEW_W*VIEW_H);
+        for (int r=0; r<size; r++) {
+                if (!viewport_part(block_of_rank[r]/blocks*edge_length, block_of_rank[r]%blocks*edge_length, edge_length, part))
+                        continue;
+                const int *src = cells;
+                if (r) {
+                        MPI_Recv(buf, part[2]*part[3], MPI_INT, r, TAG_VIEW, compute_comm, MPI_STATUS_IGNORE);
+                        src = buf;
+                }
+                for (int y=0; y<part[3]; y++)
+                        for (int x=0; x<part[2]; x++) {
+                                int *v = &view[(part[1]+y)*VIEW_W + part[0]+x];
+                                if (src[y*part[2]+x] > *v)
+                                        *v = src[y*part[2]+x];
+                        }
+        }
+
+        /* Free the pointers */
+        free(buf);
+}
+
+void close_viewport(void) {
+        MPI_Wait(&vp.req, MPI_STATUS_IGNORE);
+        free(vp.cells);
+        vp.cells = NULL;
+}
+
+
+void draw_local_grid(int *local_grid, int edge_length) {
+
+        /* Sanity check of the grid size for the LED HAT */
+        if (edge_length != 8)
+                return;
+
+        /* INCOMPLETE - adapt to the cluster */
+
+        /* Stub for drawing the grid on a Raspberry Pi LED HAT */
+        for (int y=0; y<edge_length; y++)
+                for(int x=0; x<edge_length; x++)
+                        // Replace the printf with an implementation for killing or setting the pixel at x,y.
+                        printf("%d",local_grid[y*edge_length+x]);
+}
+
+
+/* State of the GIF recorder (see write_gif_frame) */
+static struct {
+        FILE *file;             // NULL before the first frame
+        unsigned char *prev;    // Colors of the cells in the previous frame
+} gif;
+
+/* LZW codes packed into data sub-blocks of at most 255 bytes */
+typedef struct {
+        FILE *file;
+        uint32_t bits;          // Pending bits (first bit lowest)
+        int n_bits;
+        unsigned char block[255];
+        int length;
+} gif_stream;
+
+/* Write the pending sub-block */
+static void gif_flush(gif_stream *s) {
+        if (!s->length)
+                return;
+        fputc(s->length, s->file);
+        fwrite(s->block, 1, s->length, s->file);
+        s->length = 0;
+}
+
+static void gif_put_code(gif_stream *s, int code, int size) {
+        s->bits |= (uint32_t)code << s->n_bits;
+        s->n_bits += size;
+        while (s->n_bits >= 8) {
+                s->block[s->length++] = s->bits & 0xFF;
+                s->bits >>= 8;
+                s->n_bits -= 8;
+                if (s->length == 255)
+                        gif_flush(s);
+        }
+}
+
+static void gif_put_short(FILE *f, int v) {
+        fputc(v & 0xFF, f);
+        fputc(v >> 8, f);
+}
+
+/* Compress the colors of an image with variable length LZW codes (up to 12 bits) */
+static void gif_lzw(FILE *file, const unsigned char *pixels, long long n) {
+        static short trie[4096][GIF_COLORS]; // Code of a string followed by a color (0: none yet)
+        const int clear = GIF_COLORS, end = GIF_COLORS+1;
+        gif_stream s = {file, 0, 0, {0}, 0};
+        int size = GIF_MIN_CODE+1, n_codes = end+1;
+
+        fputc(GIF_MIN_CODE, file);
+        memset(trie, 0, sizeof(trie));
+        gif_put_code(&s, clear, size);
+        int prefix = pixels[0];
+        for (long long i=1; i<n; i++) {
+                if (trie[prefix][pixels[i]]) {
+                        prefix = trie[prefix][pixels[i]];
+                        continue;
+                }
+                gif_put_code(&s, prefix, size);
+                if (n_codes < 4096) {
+                        if (n_codes == (1 << size))
+                                size++;
+                        trie[prefix][pixels[i]] = n_codes++;
+                } else {
+                        /* The table is full, start over */
+                        gif_put_code(&s, clear, size);
+                        memset(trie, 0, sizeof(trie));
+                        size = GIF_MIN_CODE+1;
+                        n_codes = end+1;
+                }
+                prefix = pixels[i];
+        }
+        gif_put_code(&s, prefix, size);
+        gif_put_code(&s, end, size);
+        gif_put_code(&s, 0, 7); // Complete the last byte
+        gif_flush(&s);
+        fputc(0, file); // Block terminator
+}
+
+void write_gif_frame(const int *cells, int w, int h) {
+        /* White, black and the RGB values of the default ARR_COLORS, then greys */
+        static const unsigned char palette[GIF_COLORS][3] = {
+                {255, 255, 255}, {0, 0, 0}, {128, 0, 0}, {0, 128, 0}, {128, 128, 0}, {0, 0, 128},
+                {128, 0, 128}, {0, 128, 128}, {255, 0, 0}, {95, 255, 255}, {255, 175, 215},
+                {192, 192, 192}, {160, 160, 160}, {128, 128, 128}, {96, 96, 96}, {64, 64, 64}
+        };
+        if (!gif.file) {
+                gif.file = fopen(GIF_FILE, "wb");
+                if (!gif.file) {
+                        fprintf(stdout, "Cannot write the GIF file, aborting (gif file = %s).\n", GIF_FILE);
+                        exit(1);
+                }
+                /* Header and logical screen with the global palette */
+                fwrite("GIF89a", 1, 6, gif.file);
+                gif_put_short(gif.file, w*GIF_SCALE);
+                gif_put_short(gif.file, h*GIF_SCALE);
+                fputc(0x80 | (GIF_MIN_CODE-1) << 4 | (GIF_MIN_CODE-1), gif.file);
+                fputc(0, gif.file); // Background color
+                fputc(0, gif.file); // Square pixels
+                fwrite(palette, 1, sizeof(palette), gif.file);
+                /* Loop forever */
+                fwrite("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 1, 19, gif.file);
+        }
+
+        /* Colors of the cells and the rectangle that changed since the previous frame */
+        unsigned char *colors = malloc((size_t)w*h);
+        int x0 = w, y0 = h, x1 = -1, y1 = -1;
+        for (long long i=0; i<(long long)w*h; i++) {
+                colors[i] = (cells[i] > 1)? 2 + (cells[i]-2)%(GIF_COLORS-2) : cells[i];
+                if (!gif.prev || colors[i] != gif.prev[i]) {
+                        x0 = (i%w < x0)? i%w : x0;
+                        x1 = (i%w > x1)? i%w : x1;
+                        y0 = (i/w < y0)? i/w : y0;
+                        y1 = i/w;
+                }
+        }
+        if (x1 < 0)
+                x0 = x1 = y0 = y1 = 0; // Nothing changed, repeat one cell to keep the timing
+
+        /* Graphic control extension: keep the previous frame, delay in 1/100 s */
+        fwrite("\x21\xF9\x04\x04", 1, 4, gif.file);
+        gif_put_short(gif.file, (GEN_DELAY_MS >= 20)? GEN_DELAY_MS/10 : 2);
+        fputc(0, gif.file);
+        fputc(0, gif.file);
+
+        /* Image descriptor and the scaled pixels of the rectangle */
+        const int rect_w = (x1-x0+1)*GIF_SCALE, rect_h = (y1-y0+1)*GIF_SCALE;
+        fputc(0x2C, gif.file);
+        gif_put_short(gif.file, x0*GIF_SCALE);
+        gif_put_short(gif.file, y0*GIF_SCALE);
+        gif_put_short(gif.file, rect_w);
+        gif_put_short(gif.file, rect_h);
+        fputc(0, gif.file);
+        unsigned char *pixels = malloc((size_t)rect_w*rect_h);
+        for (int y=0; y<rect_h; y++)
+                for (int x=0; x<rect_w; x++)
+                        pixels[(long long)y*rect_w+x] = colors[(long long)(y0+y/GIF_SCALE)*w + x0+x/GIF_SCALE];
+        gif_lzw(gif.file, pixels, (long long)rect_w*rect_h);
+
+        /* Free the pointers */
+        free(pixels);
+        free(gif.prev);
+        gif.prev = colors;
+}
+
+void close_gif(void) {
+        if (!gif.file)
+                return;
+        fputc(0x3B, gif.file); // Trailer
+        fclose(gif.file);
+        free(gif.prev);
+}
+
+
+/* Store a varint (7 bits per byte, lowest first) and return its length */
+static int put_varint(unsigned char *p, unsigned long long v) {
+        int n = 0;
+        for (; v >= 0x80; v >>= 7)
+                p[n++] = (v & 0x7F) | 0x80;
+        p[n++] = v;
+        return n;
+}
+
+void write_deltas(MPI_File file, FILE *index, MPI_Offset *end, const int *local_grid, int *prev_grid, int edge_length, int gen, int keyframe) {
+        int rank;
+        MPI_Comm_rank(compute_comm, &rank);
+        if (keyframe)
+                memset(prev_grid, 0, sizeof(int) * edge_length*edge_length);
+
+        /* Room for the record header (rank 0) and a varint of the index and state per cell */
+        unsigned char *bytes = malloc(32 + (size_t)edge_length*edge_length * 8);
+        int n_changed = 0;
+        for (int i=0; i<edge_length*edge_length; i++)
+                n_changed += local_grid[i] != prev_grid[i];
+
+        /* Block of this processor (row-major order, so the indices grow) */
+        long long length = 0;
+        unsigned char *block = bytes + 32;
+        if (n_changed) {
+                length += put_varint(block, n_changed);
+                long long prev = 0;
+                for (int y=0; y<edge_length; y++) {
+                        for (int x=0; x<edge_length; x++) {
+                                const int i = y*edge_length+x;
+                                if (local_grid[i] == prev_grid[i])
+                                        continue;
+                                const long long idx = (long long)(local_y0+y)*GRID_WIDTH + local_x0+x;
+                                length += put_varint(block+length, idx-prev);
+                                if (n_states > 2)
+                                        length += put_varint(block+length, local_grid[i]);
+                                prev = idx;
+                        }
+                }
+        }
+
+        /* Offsets of the blocks and length of the record data */
+        long long offset = 0, total = 0;
+        MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, compute_comm);
+        MPI_Allreduce(&length, &total, 1, MPI_LONG_LONG, MPI_SUM, compute_comm);
+        if (!rank)
+                offset = 0; // (undefined on the first processor)
+
+        /* Stream header (first record only) and record header, written by the first processor */
+        unsigned char header[32];
+        int header_length = 0;
+        if (!*end) {
+                memcpy(header, "GOLDELTA", 8);
+                header_length = 8;
+                header_length += put_varint(header+header_length, GRID_WIDTH);
+                header_length += put_varint(header+header_length, n_states);
+        }
+        const MPI_Offset start = *end + header_length;
+        header_length += put_varint(header+header_length, gen);
+        header[header_length++] = keyframe;
+        header_length += put_varint(header+header_length, total);
+        if (!rank && keyframe && index) {
+                /* Index entry: generation and offset of the record */
+                for (int i=0; i<8; i++)
+                        fputc((unsigned long long)gen >> 8*i & 0xFF, index);
+                for (int i=0; i<8; i++)
+                        fputc((unsigned long long)start >> 8*i & 0xFF, index);
+        }
+        if (!rank) {
+                block -= header_length;
+                memcpy(block, header, header_length);
+                length += header_length;
+        } else
+                offset += header_length;
+
+        MPI_File_write_at_all(file, *end + offset, block, (int)length, MPI_BYTE, MPI_STATUS_IGNORE);
+        *end += header_length + total;
+        memcpy(prev_grid, local_grid, sizeof(int) * edge_length*edge_length);
+
+        /* Free the pointers */
+        free(bytes);
+}
+
+
+/* Read a varint from a file, -1 at the end of the file */
+static long long read_varint(FILE *f) {
+        long long v = 0;
+        for (int shift=0; ; shift+=7) {
+                const int c = fgetc(f);
+                if (c == EOF)
+                        return -1;
+                v |= (long long)(c & 0x7F) << shift;
+                if (c < 0x80)
+                        return v;
+        }
+}
+
+/* Read a varint from memory */
+static long long get_varint(const unsigned char **p) {
+        long long v = 0;
+        for (int shift=0; ; shift+=7) {
+                const int c = *(*p)++;
+                v |= (long long)(c & 0x7F) << shift;
+                if (c < 0x80)
+                        return v;
+        }
+}
+
+/* Read a 64 bit little endian number */
+static long long read_u64(FILE *f) {
+        unsigned long long v = 0;
+        for (int i=0; i<8; i++)
+                v |= (unsigned long long)(fgetc(f) & 0xFF) << 8*i;
+        return (long long)v;
+}
+
+/* Apply and draw the records of a delta stream (w x h cells) from generation from on until it ends */
+static void play_records(FILE *f, int states, int w, int h, long long from, int delay_ms) {
+        int *grid = calloc((long long)w*h, sizeof(int));
+        long long gen;
+        while ((gen = read_varint(f)) >= 0) {
+                /* Record header and data */
+                const int keyframe = fgetc(f);
+                const long long length = read_varint(f);
+                /* Zeroed padding ends a varint that is cut off at the end of the record */
+                unsigned char *data = (length >= 0)? calloc(length+10, 1) : NULL;
+                if (keyframe == EOF || !data || (long long)fread(data, 1, length, f) != length) {
+                        free(data);
+                        break;
+                }
+                if (keyframe)
+                        memset(grid, 0, sizeof(int) * (size_t)w*h);
+
+                /* Apply the blocks of all processors, stop at a cell outside the grid */
+                const unsigned char *p = data;
+                int corrupt = 0;
+                while (p < data+length && !corrupt) {
+                        const long long n = get_varint(&p);
+                        long long idx = 0;
+                        for (long long i=0; i<n; i++) {
+                                idx += get_varint(&p);
+                                if (p > data+length || idx < 0 || idx >= (long long)w*h) {
+                                        corrupt = 1;
+                                        break;
+                                }
+                                grid[idx] = (states > 2)? get_varint(&p) : !grid[idx];
+                        }
+                }
+                free(data);
+                if (corrupt) {
+                        fprintf(stdout, "The recording is corrupt, stopping (generation = %lld).\n", gen);
+                        break;
+                }
+
+                if (gen >= from) {
+                        draw_cells(grid, w, h, 0, 0, 1, GRID_WIDTH);
+                        fprintf(stdout, "Generation: %lld\n", gen);
+                        usleep(delay_ms*1000);
+                }
+        }
+
+        /* Free the pointers */
+        free(grid);
+}
+
+void replay_deltas(void) {
+        FILE *f = fopen(DELTA_FILE, "rb");
+        char magic[8];
+        if (!f || fread(magic, 1, 8, f) != 8 || memcmp(magic, "GOLDELTA", 8) || read_varint(f) != GRID_WIDTH) {
+                fprintf(stdout, "Cannot replay the recording, aborting (delta file = %s, GRID_WIDTH must match).\n", DELTA_FILE);
+                exit(1);
+        }
+        const int states = read_varint(f);
+
+        /* Jump to the last keyframe at or before REPLAY_FROM */
+        char name[256];
+        snprintf(name, sizeof(name), "%s.idx", DELTA_FILE);
+        FILE *index = fopen(name, "rb");
+        if (index && fread(magic, 1, 8, index) == 8 && !memcmp(magic, "GOLINDEX", 8)) {
+                fseek(index, 0, SEEK_END);
+                long lo = 0, hi = (ftell(index)-8)/16 - 1; // Entries are sorted by generation
+                long long offset = -1;
+                while (lo <= hi) {
+                        const long mid = (lo+hi)/2;
+                        fseek(index, 8 + mid*16, SEEK_SET);
+                        const long long gen = read_u64(index);
+                        if (gen <= REPLAY_FROM) {
+                                offset = read_u64(index);
+                                lo = mid+1;
+                        } else
+                                hi = mid-1;
+                }
+                if (offset >= 0)
+                        fseek(f, offset, SEEK_SET);
+        }
+        if (index)
+                fclose(index);
+
+        system("clear");
+        play_records(f, states, GRID_WIDTH, GRID_WIDTH, REPLAY_FROM, GEN_DELAY_MS);
+        fclose(f);
+}
+
+/* State of the frame stream to a viewer (see stream_frame) */
+static struct {
+        int server;             // Listening socket, 0 before the first call of stream_ready
+        int viewer;             // Connected viewer, 0 if none
+        int *prev;              // Cells of the last frame that was sent
+        unsigned char *out;     // Bytes not yet taken by the viewer
+        size_t length, sent;
+        int keyframe;           // The next frame is the first one for a new viewer
+} stream;
+
+/* Hand pending bytes to the viewer as far as it takes them without waiting */
+static void stream_flush(void) {
+        while (stream.viewer && stream.sent < stream.length) {
+                const ssize_t n = send(stream.viewer, stream.out+stream.sent, stream.length-stream.sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (n >= 0) {
+                        stream.sent += n;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        return;
+                } else if (errno != EINTR) {
+                        /* The viewer is gone, wait for the next one */
+                        close(stream.viewer);
+                        stream.viewer = 0;
+                }
+        }
+        stream.length = stream.sent = 0;
+}
+
+int stream_ready(void) {
+        if (!stream.server) {
+                struct sockaddr_un addr = {.sun_family = AF_UNIX};
+                if (strlen(STREAM_SOCKET) >= sizeof(addr.sun_path)) {
+                        fprintf(stdout, "The stream socket path is too long, aborting (stream socket = %s).\n", STREAM_SOCKET);
+                        exit(1);
+                }
+                strcpy(addr.sun_path, STREAM_SOCKET);
+                unlink(STREAM_SOCKET); // (left over from an earlier run)
+                stream.server = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (stream.server < 0 || bind(stream.server, (struct sockaddr *)&addr, sizeof(addr)) || listen(stream.server, 1)) {
+                        fprintf(stdout, "Cannot open the stream socket, aborting (stream socket = %s).\n", STREAM_SOCKET);
+                        exit(1);
+                }
+                fcntl(stream.server, F_SETFL, O_NONBLOCK);
+        }
+
+        /* Take a waiting viewer, it starts with a keyframe */
+        if (!stream.viewer) {
+                const int fd = accept(stream.server, NULL, NULL);
+                if (fd >= 0) {
+                        fcntl(fd, F_SETFL, O_NONBLOCK);
+                        stream.viewer = fd;
+                        stream.keyframe = 1;
+                        stream.length = stream.sent = 0;
+                }
+        }
+
+        stream_flush();
+        return stream.viewer && !stream.length;
+}
+
+void stream_frame(const int *cells, int w, int h, int gen) {
+        const int n_cells = w*h;
+        if (!stream.prev) {
+                stream.prev = malloc(sizeof(int) * n_cells);
+                stream.out = malloc(64 + (size_t)n_cells * 10);
+        }
+
+        /* Stream header in front of the first frame of a viewer, then the record header */
+        unsigned char *p = stream.out;
+        if (stream.keyframe) {
+                memset(stream.prev, 0, sizeof(int) * n_cells);
+                memcpy(p, "GOLVIDEO", 8);
+                p += 8;
+                p += put_varint(p, w);
+                p += put_varint(p, h);
+                p += put_varint(p, n_states);
+        }
+        int n_changed = 0;
+        for (int i=0; i<n_cells; i++)
+                n_changed += cells[i] != stream.prev[i];
+        p += put_varint(p, gen);
+        *p++ = stream.keyframe;
+        stream.keyframe = 0;
+
+        /* Record data: one block with the changed cells, built behind room for its length */
+        unsigned char *data = p+10, *q = data;
+        if (n_changed) {
+                q += put_varint(q, n_changed);
+                int prev = 0;
+                for (int i=0; i<n_cells; i++) {
+                        if (cells[i] == stream.prev[i])
+                                continue;
+                        q += put_varint(q, i-prev);
+                        if (n_states > 2)
+                                q += put_varint(q, cells[i]);
+                        prev = i;
+                }
+        }
+        p += put_varint(p, q-data);
+        memmove(p, data, q-data);
+        stream.length = p + (q-data) - stream.out;
+        stream.sent = 0;
+        memcpy(stream.prev, cells, sizeof(int) * n_cells);
+
+        stream_flush();
+}
+
+void close_stream(void) {
+        if (stream.viewer)
+                close(stream.viewer);
+        if (stream.server) {
+                close(stream.server);
+                unlink(STREAM_SOCKET);
+        }
+        free(stream.prev);
+        free(stream.out);
+}
+
+void view_stream(void) {
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+        strncpy(addr.sun_path, STREAM_SOCKET, sizeof(addr.sun_path)-1);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+                fprintf(stdout, "Cannot open a socket, aborting.\n");
+                exit(1);
+        }
+
+        /* Wait for the simulation to open the stream */
+        fprintf(stdout, "Waiting for the simulation (stream socket = %s).\n", STREAM_SOCKET);
+        fflush(stdout);
+        while (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+                usleep(100*1000);
+
+        FILE *f = fdopen(fd, "rb");
+        char magic[8];
+        if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "GOLVIDEO", 8)) {
+                fprintf(stdout, "Not a frame stream, aborting (stream socket = %s).\n", STREAM_SOCKET);
+                exit(1);
+        }
+        const int w = read_varint(f);
+        const int h = read_varint(f);
+        const int states = read_varint(f);
+
+        /* Draw the frames as they arrive */
+        system("clear");
+        play_records(f, states, w, h, 0, 0);
+        fclose(f);
+}
+
+
+/* Store / load a 32 bit little endian number */
+static void put_le32(unsigned char *p, unsigned int v) {
+        for (int i=0; i<4; i++)
+                p[i] = v >> 8*i;
+}
+
+static unsigned int get_le32(const unsigned char *p) {
+        return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+/* Edge length of the tiles of incremental checkpoints */
+static int checkpoint_tile(int edge_length) {
+        return (edge_length % CKPT_TILE)? edge_length : CKPT_TILE;
+}
+
+int checkpoint_length(int edge_length) {
+        /* Header, all cells and the row and column of every tile */
+        const int tiles = edge_length/checkpoint_tile(edge_length);
+        return 5 + edge_length*edge_length + 2*tiles*tiles;
+}
+
+void write_checkpoint(MPI_Comm comm, int n_blocks, int **blocks, int edge_length) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        const int gen = blocks[0][0], base_gen = blocks[0][3];
+        const int full = (base_gen == gen);
+        const int tile = checkpoint_tile(edge_length);
+        char name[256];
+        snprintf(name, sizeof(name), CHECKPOINT_FILE, gen);
+
+        /* Bytes of the tiles of this processor in an incremental checkpoint and their offset */
+        long long length = 0, offset = 0;
+        for (int b=0; b<n_blocks && !full; b++)
+                length += (long long)blocks[b][4] * (8+tile*tile);
+        if (!full)
+                MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+        if (!rank)
+                offset = 0; // (undefined on the first processor)
+
+        MPI_File file;
+        MPI_File_open(comm, name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+        MPI_File_set_size(file, 0); // Truncate an older checkpoint
+        if (!rank) {
+                unsigned char header[CKPT_INC_HEADER];
+                memcpy(header, full? "GOLCHECK" : "GOLCHINC", 8);
+                put_le32(header+8, GRID_WIDTH);
+                put_le32(header+12, gen);
+                put_le32(header+16, n_states);
+                put_le32(header+20, base_gen);
+                put_le32(header+24, tile);
+                MPI_File_write_at(file, 0, header, full? CKPT_HEADER : CKPT_INC_HEADER, MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+
+        if (full) {
+                /* Every block through a subarray view of the grid, one collective write per block
+                 * (processors with fewer blocks take part with an empty write) */
+                int max_blocks;
+                MPI_Allreduce(&n_blocks, &max_blocks, 1, MPI_INT, MPI_MAX, comm);
+                const int sizes[2] = {GRID_WIDTH, GRID_WIDTH};
+                const int subsizes[2] = {edge_length, edge_length};
+                unsigned char *cells = malloc(edge_length*edge_length);
+                for (int b=0; b<max_blocks; b++) {
+                        MPI_Datatype block_type = MPI_BYTE;
+                        int count = 0;
+                        if (b < n_blocks) {
+                                const int starts[2] = {blocks[b][1], blocks[b][2]};
+                                MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_BYTE, &block_type);
+                                MPI_Type_commit(&block_type);
+                                for (int i=0; i<edge_length*edge_length; i++)
+                                        cells[i] = blocks[b][5+i];
+                                count = edge_length*edge_length;
+                        }
+                        MPI_File_set_view(file, CKPT_HEADER, MPI_BYTE, block_type, "native", MPI_INFO_NULL);
+                        MPI_File_write_all(file, cells, count, MPI_BYTE, MPI_STATUS_IGNORE);
+                        if (b < n_blocks)
+                                MPI_Type_free(&block_type);
+                }
+                free(cells);
+        } else {
+                /* Tiles of the blocks, in one piece per processor */
+                unsigned char *bytes = malloc(length+1), *q = bytes;
+                for (int b=0; b<n_blocks; b++) {
+                        const int *p = blocks[b]+5;
+                        for (int t=0; t<blocks[b][4]; t++) {
+                                put_le32(q, p[0]);
+                                put_le32(q+4, p[1]);
+                                q += 8;
+                                p += 2;
+                                for (int i=0; i<tile*tile; i++)
+                                        *q++ = *p++;
+                        }
+                }
+                MPI_File_write_at_all(file, CKPT_INC_HEADER+offset, bytes, length, MPI_BYTE, MPI_STATUS_IGNORE);
+                free(bytes);
+        }
+        MPI_File_close(&file);
+}
+
+void checkpoint(int *buf, MPI_Request *req, const int *local_grid, int *base_grid, int base_gen, int edge_length, int gen) {
+        /* The previous snapshot must have left the buffer */
+        MPI_Wait(req, MPI_STATUS_IGNORE);
+        buf[0] = gen;
+        buf[1] = local_y0;
+        buf[2] = local_x0;
+        buf[3] = base_gen;
+        int length = 5;
+        if (base_gen == gen) {
+                /* Full checkpoint, which the following incremental ones refer to */
+                if (base_grid)
+                        memcpy(base_grid, local_grid, sizeof(int) * edge_length*edge_length);
+                memcpy(buf+5, local_grid, sizeof(int) * edge_length*edge_length);
+                buf[4] = 0;
+                length += edge_length*edge_length;
+        } else {
+                /* Tiles with a cell that changed since the full checkpoint */
+                const int tile = checkpoint_tile(edge_length);
+                int n_tiles = 0;
+                for (int ty=0; ty<edge_length; ty+=tile) {
+                        for (int tx=0; tx<edge_length; tx+=tile) {
+                                int dirty = 0;
+                                for (int y=ty; y<ty+tile && !dirty; y++)
+                                        dirty = memcmp(local_grid+y*edge_length+tx, base_grid+y*edge_length+tx, sizeof(int) * tile) != 0;
+                                if (!dirty)
+                                        continue;
+                                buf[length++] = local_y0+ty;
+                                buf[length++] = local_x0+tx;
+                                for (int y=ty; y<ty+tile; y++, length+=tile)
+                                        memcpy(buf+length, local_grid+y*edge_length+tx, sizeof(int) * tile);
+                                n_tiles++;
+                        }
+                }
+                buf[4] = n_tiles;
+        }
+
+        if (IO_RANKS > 0) {
+                int rank, size;
+                MPI_Comm_rank(compute_comm, &rank);
+                MPI_Comm_size(compute_comm, &size);
+                MPI_Isend(buf, length, MPI_INT, io_processor(rank, size), TAG_CKPT, MPI_COMM_WORLD, req);
+        } else
+                write_checkpoint(compute_comm, 1, &buf, edge_length);
+}
+
+int io_processor(int rank, int n_compute) {
+        /* The I/O processors follow the computing processors in MPI_COMM_WORLD */
+        return n_compute + rank % (IO_RANKS > 0? IO_RANKS : 1);
+}
+
+void io_server(MPI_Comm io_comm, int n_compute) {
+        int io_rank;
+        MPI_Comm_rank(io_comm, &io_rank);
+        const int edge_length = (int)sqrt(TOTAL_GRID_SIZE / n_compute);
+        int n_blocks = 0;
+        for (int r=io_rank; r<n_compute; r+=IO_RANKS)
+                n_blocks++;
+
+        int **blocks = calloc(n_blocks, sizeof(int *));
+
+        while (1) {
+                /* All computing processors save the same generations (each block only as large as its packet) */
+                for (int b=0; b<n_blocks; b++) {
+                        MPI_Status status;
+                        int count;
+                        MPI_Probe(io_rank + b*IO_RANKS, TAG_CKPT, MPI_COMM_WORLD, &status);
+                        MPI_Get_count(&status, MPI_INT, &count);
+                        blocks[b] = realloc(blocks[b], sizeof(int) * count);
+                        MPI_Recv(blocks[b], count, MPI_INT, io_rank + b*IO_RANKS, TAG_CKPT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                }
+                if (blocks[0][0] < 0)
+                        break;
+                write_checkpoint(io_comm, n_blocks, blocks, edge_length);
+        }
+
+        /* Free the pointers */
+        for (int b=0; b<n_blocks; b++)
+                free(blocks[b]);
+        free(blocks);
+}
+
+/* Open a checkpoint and read its header (CKPT_INC_HEADER bytes for an incremental one). Aborts if it does not fit. */
+static MPI_File open_checkpoint(const char *name, unsigned char *header) {
+        MPI_File file;
+        int count = 0;
+        if (MPI_File_open(compute_comm, name, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) == MPI_SUCCESS) {
+                MPI_Status status;
+                MPI_File_read_at_all(file, 0, header, CKPT_INC_HEADER, MPI_BYTE, &status);
+                MPI_Get_count(&status, MPI_BYTE, &count);
+        }
+        if (count < CKPT_HEADER || (memcmp(header, "GOLCHECK", 8) && (memcmp(header, "GOLCHINC", 8) || count < CKPT_INC_HEADER)) ||
+            get_le32(header+8) != GRID_WIDTH || (int)get_le32(header+16) != n_states) {
+                fprintf(stdout, "Cannot restart from the checkpoint, aborting (checkpoint file = %s, GRID_WIDTH and states must match).\n", name);
+                exit(1);
+        }
+        return file;
+}
+
+int read_checkpoint(int *local_grid, int edge_length) {
+        unsigned char header[CKPT_INC_HEADER];
+        MPI_File file = open_checkpoint(RESTART_FILE, header), full = file;
+        const int incremental = !memcmp(header, "GOLCHINC", 8);
+        const unsigned int base_gen = get_le32(header+20);
+        char name[256] = RESTART_FILE;
+        if (incremental) {
+                /* Start from the full checkpoint the tiles refer to (in the directory of the incremental one) */
+                unsigned char full_header[CKPT_INC_HEADER];
+                char base[128];
+                snprintf(base, sizeof(base), CHECKPOINT_FILE, base_gen);
+                const char *dir_end = strrchr(RESTART_FILE, '/'), *base_name = strrchr(base, '/');
+                snprintf(name, sizeof(name), "%.*s%s", dir_end? (int)(dir_end-RESTART_FILE+1) : 0, RESTART_FILE,
+                         base_name? base_name+1 : base);
+                full = open_checkpoint(name, full_header);
+                if (memcmp(full_header, "GOLCHECK", 8) || get_le32(full_header+12) != base_gen) {
+                        fprintf(stdout, "The full checkpoint does not belong to the incremental one, aborting (checkpoint file = %s).\n", name);
+                        exit(1);
+                }
+        }
+
+        /* The own block of the grid */
+        const int sizes[2] = {GRID_WIDTH, GRID_WIDTH};
+        const int subsizes[2] = {edge_length, edge_length};
+        const int starts[2] = {local_y0, local_x0};
+        MPI_Datatype block_type;
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_BYTE, &block_type);
+        MPI_Type_commit(&block_type);
+        MPI_File_set_view(full, CKPT_HEADER, MPI_BYTE, block_type, "native", MPI_INFO_NULL);
+
+        unsigned char *cells = malloc(edge_length*edge_length);
+        MPI_Status status;
+        int count;
+        MPI_File_read_all(full, cells, edge_length*edge_length, MPI_BYTE, &status);
+        MPI_Get_count(&status, MPI_BYTE, &count);
+        if (count != edge_length*edge_length) {
+                fprintf(stdout, "The checkpoint is incomplete, aborting (checkpoint file = %s).\n", name);
+                exit(1);
+        }
+        for (int i=0; i<edge_length*edge_length; i++)
+                local_grid[i] = cells[i];
+
+        if (incremental) {
+                /* Apply the parts of the tiles that overlap the own block */
+                const unsigned int tile = get_le32(header+24);
+                MPI_Offset file_size;
+                MPI_File_get_size(file, &file_size);
+                const int length = file_size - CKPT_INC_HEADER;
+                if (!tile || tile > GRID_WIDTH || length % (8+tile*tile)) {
+                        fprintf(stdout, "The checkpoint is broken, aborting (checkpoint file = %s).\n", RESTART_FILE);
+                        exit(1);
+                }
+                unsigned char *tiles = malloc(length+1);
+                MPI_File_read_at_all(file, CKPT_INC_HEADER, tiles, length, MPI_BYTE, MPI_STATUS_IGNORE);
+                for (const unsigned char *record = tiles; record < tiles+length; record += 8+tile*tile) {
+                        const int y0 = get_le32(record), x0 = get_le32(record+4);
+                        if (y0 < 0 || x0 < 0 || y0 > GRID_WIDTH-(int)tile || x0 > GRID_WIDTH-(int)tile) {
+                                fprintf(stdout, "The checkpoint is broken, aborting (checkpoint file = %s).\n", RESTART_FILE);
+                                exit(1);
+                        }
+                        const int y_begin = (y0 > local_y0)? y0 : local_y0, y_end = (y0+(int)tile < local_y0+edge_length)? y0+(int)tile : local_y0+edge_length;
+                        const int x_begin = (x0 > local_x0)? x0 : local_x0, x_end = (x0+(int)tile < local_x0+edge_length)? x0+(int)tile : local_x0+edge_length;
+                        for (int y=y_begin; y<y_end; y++)
+                                for (int x=x_begin; x<x_end; x++)
+                                        local_grid[(y-local_y0)*edge_length + x-local_x0] = record[8 + (y-y0)*tile + x-x0];
+                }
+                free(tiles);
+                MPI_File_close(&full);
+        }
 
-                // Combine the box and inbox offsets to calculate original index
-                int new_col = box_col * edge_length + inbox_col;
-                int new_row = (box_row * edge_length + inbox_row) * GRID_WIDTH;
+        /* Free the pointers */
+        free(cells);
+        MPI_Type_free(&block_type);
+        MPI_File_close(&file);
+        return get_le32(header+12);
+}
 
-                grid[new_row + new_col] = copy_grid[i];
+
+void write_board(const int *local_grid, int edge_length) {
+        const int tile = (edge_length % BOARD_TILE)? edge_length : BOARD_TILE;
+        const int row_bytes = (tile+7)/8, tile_bytes = tile*row_bytes;
+        const int tiles = GRID_WIDTH/tile, block_tiles = edge_length/tile;
+
+        MPI_File file;
+        MPI_File_open(compute_comm, BOARD_WRITE, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+        MPI_File_set_size(file, 0); // Truncate an older board
+        int rank;
+        MPI_Comm_rank(compute_comm, &rank);
+        if (!rank) {
+                unsigned char header[BOARD_HEADER];
+                memcpy(header, "GOLBOARD", 8);
+                put_le32(header+8, GRID_WIDTH);
+                put_le32(header+12, tile);
+                MPI_File_write_at(file, 0, header, BOARD_HEADER, MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+
+        /* Pack the tiles of a row of tiles and write them in one piece */
+        unsigned char *bytes = malloc(block_tiles*tile_bytes);
+        for (int ty=0; ty<block_tiles; ty++) {
+                memset(bytes, 0, block_tiles*tile_bytes);
+                for (int y=0; y<tile; y++)
+                        for (int x=0; x<edge_length; x++)
+                                if (local_grid[(ty*tile+y)*edge_length+x])
+                                        bytes[x/tile*tile_bytes + y*row_bytes + x%tile/8] |= 1 << (x%tile%8);
+                const MPI_Offset offset = BOARD_HEADER + ((MPI_Offset)(local_y0/tile+ty)*tiles + local_x0/tile)*tile_bytes;
+                MPI_File_write_at_all(file, offset, bytes, block_tiles*tile_bytes, MPI_BYTE, MPI_STATUS_IGNORE);
         }
+        MPI_File_close(&file);
+
+        /* Free the pointers */
+        free(bytes);
 }
 
-void draw_grid(int grid[TOTAL_GRID_SIZE], int edge_length) {
+const unsigned char *map_board(size_t *length, int *tile) {
+        const int fd = open(BOARD_FILE, O_RDONLY);
+        const off_t size = (fd < 0)? 0 : lseek(fd, 0, SEEK_END);
+        const unsigned char *board = (size < BOARD_HEADER)? MAP_FAILED : mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (fd >= 0)
+                close(fd); // (the mapping stays)
+        if (board == MAP_FAILED) {
+                fprintf(stdout, "Cannot map the board file, aborting (board file = %s).\n", BOARD_FILE);
+                exit(1);
+        }
 
-        fprintf(stdout, S_TOPLEFT);
-        for (int y=0; y<GRID_WIDTH; y++){
-                for(int x=0; x<GRID_WIDTH; x++)
-                        if (COLOR_SUB_GRIDS) {
-                                /* Get corresponding processor index for this pixel */
-                                int pi = ((int)(y/edge_length))*(GRID_WIDTH/edge_length)+((int)(x/edge_length));
-                                fprintf(stdout, "%s  %s", grid[y*GRID_WIDTH+x] ? C_B_BLACK : ARR_COLORS[pi%NUM_COLORS], ARR_COLORS[pi%NUM_COLORS]);
-                        } else
-                                fprintf(stdout, "%s  %s", grid[y*GRID_WIDTH+x] ? C_B_BLACK : C_B_WHITE, C_B_WHITE);
-                fprintf(stdout, "\n");
+        /* The tiles must cover the grid exactly */
+        *length = size;
+        *tile = get_le32(board+12);
+        if (memcmp(board, "GOLBOARD", 8) || get_le32(board+8) != GRID_WIDTH || *tile <= 0 || GRID_WIDTH % *tile ||
+            size != BOARD_HEADER + (off_t)GRID_WIDTH*GRID_WIDTH / *tile * ((*tile+7)/8)) {
+                fprintf(stdout, "The board file does not fit the grid, aborting (board file = %s, GRID_WIDTH = %d).\n", BOARD_FILE, GRID_WIDTH);
+                exit(1);
         }
-        fprintf(stdout, C_RST);
-        fflush(stdout);
+        return board;
 }
 
+void unpack_board_row(const unsigned char *board, int tile, int y, int x, int w, int *cells) {
+        const int row_bytes = (tile+7)/8, tile_bytes = tile*row_bytes, tiles = GRID_WIDTH/tile;
+        const unsigned char *row = board + BOARD_HEADER + ((size_t)(y/tile)*tiles)*tile_bytes + (y%tile)*row_bytes;
 
-void draw_local_grid(int *local_grid, int edge_length) {
+        /* Cells of one tile after the other */
+        for (int i=0; i<w; ) {
+                const unsigned char *bits = row + (size_t)((x+i)/tile)*tile_bytes;
+                for (int c=(x+i)%tile; c<tile && i<w; c++, i++)
+                        cells[i] = (bits[c/8] >> (c%8)) & 1;
+        }
+}
 
-        /* Sanity check of the grid size for the LED HAT */
-        if (edge_length != 8)
-                return;
 
-        /* INCOMPLETE - adapt to the cluster */
+void write_frame(const int *local_grid, int edge_length, int gen) {
+        /* Bytes per row of the image and of the local part, and the offset of the local part */
+        const int pbm = (FRAME_FORMAT == FRAME_PBM);
+        const int scale = pbm? 1 : FRAME_SCALE;
+        const int cells_per_byte = pbm? 8 : 1;
+        const int sizes[2] = {GRID_WIDTH/scale, GRID_WIDTH/scale/cells_per_byte};
+        const int subsizes[2] = {edge_length/scale, edge_length/scale/cells_per_byte};
+        const int starts[2] = {local_y0/scale, local_x0/scale/cells_per_byte};
 
-        /* Stub for drawing the grid on a Raspberry Pi LED HAT */
-        for (int y=0; y<edge_length; y++)
-                for(int x=0; x<edge_length; x++)
-                        // Replace the printf with an implementation for killing or setting the pixel at x,y.
-                        printf("%d",local_grid[y*edge_length+x]);
+        /* Convert the local grid */
+        unsigned char *bytes = calloc(subsizes[0]*subsizes[1], 1);
+        for (int y=0; y<subsizes[0]; y++) {
+                for (int x=0; x<edge_length/scale; x++) {
+                        if (pbm) {
+                                if (local_grid[y*edge_length+x])
+                                        bytes[y*subsizes[1]+x/8] |= 0x80 >> (x%8); // Leftmost pixel in the highest bit
+                                continue;
+                        }
+                        int alive = 0;
+                        for (int i=0; i<scale; i++)
+                                for (int j=0; j<scale; j++)
+                                        alive += local_grid[(y*scale+i)*edge_length+x*scale+j] != 0;
+                        bytes[y*subsizes[1]+x] = 255 - 255*alive/(scale*scale);
+                }
+        }
+
+        char name[256], header[64];
+        snprintf(name, sizeof(name), FRAME_FILE, gen);
+        const int header_length = pbm? snprintf(header, sizeof(header), "P4\n%d %d\n", GRID_WIDTH, GRID_WIDTH)
+                                     : snprintf(header, sizeof(header), "P5\n%d %d\n255\n", sizes[1], sizes[0]);
+
+        MPI_File file;
+        MPI_Datatype view;
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_BYTE, &view);
+        MPI_Type_commit(&view);
+        MPI_File_open(compute_comm, name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+        MPI_File_set_size(file, 0); // Truncate older frames
+        if (!local_y0 && !local_x0) // The processor with the upper left corner writes the header
+                MPI_File_write_at(file, 0, header, header_length, MPI_CHAR, MPI_STATUS_IGNORE);
+        MPI_File_set_view(file, header_length, MPI_BYTE, view, "native", MPI_INFO_NULL);
+        MPI_File_write_all(file, bytes, subsizes[0]*subsizes[1], MPI_BYTE, MPI_STATUS_IGNORE);
+        MPI_File_close(&file);
+
+        /* Free the pointers */
+        MPI_Type_free(&view);
+        free(bytes);
 }
 
 
@@ -521,3 +3443,1076 @@ void get_neighbour_ids(int proc_ids[8], int rank, int n_procs) {
         proc_ids[6] = (row<(ppl-1))? rank+ppl : col; // down
         proc_ids[7] = (row<(ppl-1) && col<(ppl-1))? rank+ppl+1 : ((row<(ppl-1))? rank+1 : ((col<(ppl-1))? col+1: 0));// down right
 }
+
+
+void exchange_eight_way(int *local_grid, int width, int neigh_procs[8], int *ups, int *downs, int *lefts, int *rights) {
+        const int size = width*width;
+
+        /* Expose own corners (only those the neighbourhood uses) */
+        if (NEIGHBOURHOOD & NB_DR)
+                MPI_Send(&local_grid[0], 1, MPI_INT, neigh_procs[0], TAG_DR, compute_comm); // expose up-left
+        if (NEIGHBOURHOOD & NB_DL)
+                MPI_Send(&local_grid[width-1], 1, MPI_INT, neigh_procs[2], TAG_DL, compute_comm); // expose up-right
+        if (NEIGHBOURHOOD & NB_UR)
+                MPI_Send(&local_grid[size-width], 1, MPI_INT, neigh_procs[5], TAG_UR, compute_comm); // expose lower left
+        if (NEIGHBOURHOOD & NB_UL)
+                MPI_Send(&local_grid[size-1], 1, MPI_INT, neigh_procs[7], TAG_UL, compute_comm); // expose lower right
+
+        /* Get own borders */
+        for (int i=0; i<width;i++) {
+                ups[i+1] = local_grid[i];
+                lefts[i] = local_grid[i*width];
+                rights[i] = local_grid[(i+1)*width-1];
+                downs[i+1] = local_grid[size-width+i];
+        }
+
+        /* Expose own borders */
+        if (NEIGHBOURHOOD & NB_ROW_BELOW)
+                MPI_Send(ups+1, width, MPI_INT, neigh_procs[1], TAG_DO, compute_comm); // expose ups
+        if (NEIGHBOURHOOD & NB_COL_RIGHT)
+                MPI_Send(lefts, width, MPI_INT, neigh_procs[3], TAG_RI, compute_comm); // expose lefts
+        if (NEIGHBOURHOOD & NB_COL_LEFT)
+                MPI_Send(rights, width, MPI_INT, neigh_procs[4], TAG_LE, compute_comm); // expose rights
+        if (NEIGHBOURHOOD & NB_ROW_ABOVE)
+                MPI_Send(downs+1, width, MPI_INT, neigh_procs[6], TAG_UP, compute_comm); // expose downs
+
+        /* Collect adjacent corners */
+        if (NEIGHBOURHOOD & NB_UL)
+                MPI_Recv(&ups[0], 1, MPI_INT, neigh_procs[0], TAG_UL, compute_comm, MPI_STATUS_IGNORE); // receive upper left
+        if (NEIGHBOURHOOD & NB_UR)
+                MPI_Recv(&ups[width+1], 1, MPI_INT, neigh_procs[2], TAG_UR, compute_comm, MPI_STATUS_IGNORE); // receive upper right
+        if (NEIGHBOURHOOD & NB_DL)
+                MPI_Recv(&downs[0], 1, MPI_INT, neigh_procs[5], TAG_DL, compute_comm, MPI_STATUS_IGNORE); // receive down left
+        if (NEIGHBOURHOOD & NB_DR)
+                MPI_Recv(&downs[width+1], 1, MPI_INT, neigh_procs[7], TAG_DR, compute_comm, MPI_STATUS_IGNORE); // receive down right
+
+        /* Collect adjacent borders */
+        if (NEIGHBOURHOOD & NB_ROW_ABOVE)
+                MPI_Recv(ups+1, width, MPI_INT, neigh_procs[1], TAG_UP, compute_comm, MPI_STATUS_IGNORE); // receive ups
+        if (NEIGHBOURHOOD & NB_ROW_BELOW)
+                MPI_Recv(downs+1, width, MPI_INT, neigh_procs[6], TAG_DO, compute_comm, MPI_STATUS_IGNORE); // receive downs
+        if (NEIGHBOURHOOD & NB_COL_LEFT)
+                MPI_Recv(lefts, width, MPI_INT, neigh_procs[3], TAG_LE, compute_comm, MPI_STATUS_IGNORE); // receive lefts
+        if (NEIGHBOURHOOD & NB_COL_RIGHT)
+                MPI_Recv(rights, width, MPI_INT, neigh_procs[4], TAG_RI, compute_comm, MPI_STATUS_IGNORE); // receive rights
+}
+
+
+void exchange_two_phase(int *local_grid, int width, int neigh_procs[8], int *ups, int *downs, int *lefts, int *rights) {
+        const int size = width*width;
+
+        /* Phase 1: swap columns with the left and right neighbours.
+         * Each buffer is filled with the column that is sent away and then replaced by the
+         * column that arrives from the opposite side (MPI_Sendrecv_replace). */
+        for (int i=0; i<width; i++) {
+                rights[i] = local_grid[i*width];          // own left column travels to the left ...
+                lefts[i] = local_grid[(i+1)*width-1];     // ... own right column travels to the right
+        }
+        if (NEIGHBOURHOOD & NB_COL_RIGHT)
+                MPI_Sendrecv_replace(rights, width, MPI_INT, neigh_procs[3], TAG_RI, neigh_procs[4], TAG_RI, compute_comm, MPI_STATUS_IGNORE);
+        if (NEIGHBOURHOOD & NB_COL_LEFT)
+                MPI_Sendrecv_replace(lefts, width, MPI_INT, neigh_procs[4], TAG_LE, neigh_procs[3], TAG_LE, compute_comm, MPI_STATUS_IGNORE);
+
+        /* Phase 2: swap full-width rows (own row plus the ghost columns) with the upper and lower
+         * neighbours. The ghost values at both ends are the corners of the diagonal neighbours. */
+        downs[0] = lefts[0];                              // own top row travels up ...
+        memcpy(downs+1, local_grid, sizeof(int)*width);
+        downs[width+1] = rights[0];
+        ups[0] = lefts[width-1];                          // ... own bottom row travels down
+        memcpy(ups+1, &local_grid[size-width], sizeof(int)*width);
+        ups[width+1] = rights[width-1];
+        if (NEIGHBOURHOOD & NB_ROW_BELOW)
+                MPI_Sendrecv_replace(downs, width+2, MPI_INT, neigh_procs[1], TAG_DO, neigh_procs[6], TAG_DO, compute_comm, MPI_STATUS_IGNORE);
+        if (NEIGHBOURHOOD & NB_ROW_ABOVE)
+                MPI_Sendrecv_replace(ups, width+2, MPI_INT, neigh_procs[6], TAG_UP, neigh_procs[1], TAG_UP, compute_comm, MPI_STATUS_IGNORE);
+}
+
+
+void get_block_layout(int *block_of_rank, int *rank_of_block, int rank, int n_procs) {
+        const int ppl = (int)sqrt(n_procs);
+        int block = rank; // Row by row by default
+
+        if (NODE_AWARE_LAYOUT) {
+                /* Group the processors by shared-memory node */
+                MPI_Comm node_comm, leader_comm;
+                int node_rank, node_size, min_size, max_size, node_id = 0;
+                MPI_Comm_split_type(compute_comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+                MPI_Comm_rank(node_comm, &node_rank);
+                MPI_Comm_size(node_comm, &node_size);
+                MPI_Allreduce(&node_size, &min_size, 1, MPI_INT, MPI_MIN, compute_comm);
+                MPI_Allreduce(&node_size, &max_size, 1, MPI_INT, MPI_MAX, compute_comm);
+
+                /* Number the nodes by letting the first processor of each node join a leader communicator */
+                MPI_Comm_split(compute_comm, node_rank ? MPI_UNDEFINED : 0, rank, &leader_comm);
+                if (!node_rank) {
+                        MPI_Comm_rank(leader_comm, &node_id);
+                        MPI_Comm_free(&leader_comm);
+                }
+                MPI_Bcast(&node_id, 1, MPI_INT, 0, node_comm);
+                MPI_Comm_free(&node_comm);
+
+                /* Find the most square super-block of nr x nc blocks that tiles the grid */
+                int nr = 0;
+                if (min_size == max_size)
+                        for (int r=1; r*r<=node_size; r++)
+                                if (!(node_size%r) && !(ppl%r) && !(ppl%(node_size/r)))
+                                        nr = r;
+
+                if (nr) {
+                        const int nc = node_size/nr;
+                        const int nodes_per_row = ppl/nc;
+                        const int row = (node_id/nodes_per_row)*nr + node_rank/nc;
+                        const int col = (node_id%nodes_per_row)*nc + node_rank%nc;
+                        block = row*ppl + col;
+                        if (!rank && max_size < n_procs)
+                                fprintf(stdout, "Node-aware layout: %d nodes with %dx%d processors each\n", n_procs/node_size, nr, nc);
+                } else if (!rank)
+                        fprintf(stdout, "Node sizes do not tile the grid, using row by row layout.\n");
+        }
+
+        /* Let every processor know the block of every other processor */
+        MPI_Allgather(&block, 1, MPI_INT, block_of_rank, 1, MPI_INT, compute_comm);
+        for (int i=0; i<n_procs; i++)
+                rank_of_block[block_of_rank[i]] = i;
+}
+
+
+/* Apply the block rule to all 2x2 blocks of an n x n region (n even) */
+static void margolus_blocks(int *b, int stride, int n) {
+        for (int y=0; y<n; y+=2) {
+                for (int x=0; x<n; x+=2) {
+                        int *c = &b[y*stride+x];
+                        const int next = margolus_table[c[0] | c[1] << 1 | c[stride] << 2 | c[stride+1] << 3];
+                        c[0] = next & 1;
+                        c[1] = (next >> 1) & 1;
+                        c[stride] = (next >> 2) & 1;
+                        c[stride+1] = (next >> 3) & 1;
+                }
+        }
+}
+
+void margolus_step(int *g, int width, int gen, int neigh_procs[8]) {
+        if (!(gen % 2)) {
+                margolus_blocks(g, width, width);
+                return;
+        }
+
+        /* Copy of the local grid with one more row and column for the shifted blocks */
+        const int stride = width+1;
+        int *b = malloc(sizeof(int) * stride*stride);
+        for (int y=0; y<width; y++)
+                memcpy(&b[y*stride], &g[y*width], sizeof(int)*width);
+        MPI_Datatype col_type;
+        MPI_Type_vector(width, 1, stride, MPI_INT, &col_type);
+        MPI_Type_commit(&col_type);
+
+        /* Fetch the first column of the right neighbour, then the first row of the lower neighbour */
+        MPI_Sendrecv(&b[0], 1, col_type, neigh_procs[3], TAG_RI,
+                     &b[width], 1, col_type, neigh_procs[4], TAG_RI, compute_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(&b[1], width, MPI_INT, neigh_procs[1], TAG_DO,
+                     &b[width*stride+1], width, MPI_INT, neigh_procs[6], TAG_DO, compute_comm, MPI_STATUS_IGNORE);
+
+        margolus_blocks(&b[stride+1], stride, width);
+
+        /* Return the last row to the lower neighbour, then the last column (with the corner) to the right neighbour */
+        MPI_Sendrecv(&b[width*stride+1], width, MPI_INT, neigh_procs[6], TAG_UP,
+                     &b[1], width, MPI_INT, neigh_procs[1], TAG_UP, compute_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(&b[width], 1, col_type, neigh_procs[4], TAG_LE,
+                     &b[0], 1, col_type, neigh_procs[3], TAG_LE, compute_comm, MPI_STATUS_IGNORE);
+
+        for (int y=0; y<width; y++)
+                memcpy(&g[y*width], &b[y*stride], sizeof(int)*width);
+
+        /* Free the pointers */
+        MPI_Type_free(&col_type);
+        free(b);
+}
+
+
+void exchange_deep(int *local_grid, int *deep_grid, int width, int depth, int neigh_procs[8], MPI_Datatype col_type) {
+        const int stride = width+2*depth;
+        int *inner = &deep_grid[depth*stride+depth];
+
+        /* Copy the local grid into the centre */
+        for (int y=0; y<width; y++)
+                memcpy(&inner[y*stride], &local_grid[y*width], sizeof(int)*width);
+
+        /* Phase 1: swap depth columns with the left and right neighbours */
+        MPI_Sendrecv(inner, 1, col_type, neigh_procs[3], TAG_RI,
+                     inner+width, 1, col_type, neigh_procs[4], TAG_RI, compute_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(inner+width-depth, 1, col_type, neigh_procs[4], TAG_LE,
+                     inner-depth, 1, col_type, neigh_procs[3], TAG_LE, compute_comm, MPI_STATUS_IGNORE);
+
+        /* Phase 2: swap depth full-width rows (including the ghost columns) with the upper and lower neighbours */
+        MPI_Sendrecv(&deep_grid[depth*stride], depth*stride, MPI_INT, neigh_procs[1], TAG_DO,
+                     &deep_grid[(depth+width)*stride], depth*stride, MPI_INT, neigh_procs[6], TAG_DO, compute_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(&deep_grid[width*stride], depth*stride, MPI_INT, neigh_procs[6], TAG_UP,
+                     deep_grid, depth*stride, MPI_INT, neigh_procs[1], TAG_UP, compute_comm, MPI_STATUS_IGNORE);
+}
+
+
+/* Rotate a 3x3 neighbourhood (row-major bits) by 90 degrees t%4 times, mirrored if t >= 4 */
+static int transform_neighbourhood(int n, int t) {
+        for (int r=0; r<t%4; r++) {
+                int rotated = 0;
+                for (int i=0; i<9; i++)
+                        if ((n >> i) & 1)
+                                rotated |= 1 << ((i%3)*3 + 2-i/3); // (row, col) -> (col, 2-row)
+                n = rotated;
+        }
+        if (t >= 4) {
+                int mirrored = 0;
+                for (int i=0; i<9; i++)
+                        if ((n >> i) & 1)
+                                mirrored |= 1 << ((i/3)*3 + 2-i%3);
+                n = mirrored;
+        }
+        return n;
+}
+
+int parse_rule(const char *rule, int mask, unsigned char table[512], int *totalistic) {
+        /* Hensel letters and their canonical neighbourhoods for 1..4 neighbours (row-major bits,
+         * centre bit 4 unset). Neighbourhoods with 5..7 neighbours are the complements of 3..1. */
+        static const char *letters[5] = {"", "ce", "ceaikn", "ceaiknjqry", "ceaiknjqrytwz"};
+        static const short shapes[5][13] = {
+                {0},
+                {1, 2},
+                {5, 10, 3, 40, 33, 68},
+                {69, 42, 11, 7, 98, 13, 14, 70, 41, 97},
+                {325, 170, 15, 45, 99, 71, 106, 102, 43, 101, 105, 78, 108}
+        };
+
+        memset(table, 0, 512);
+        int part = -1; // 0: birth, 1: survival
+        const char *c = rule;
+        while (*c) {
+                const char u = toupper(*c);
+                if (u == 'B' || u == 'S') {
+                        part = (u == 'S');
+                        c++;
+                        continue;
+                }
+                if (*c == '/') {
+                        c++;
+                        continue;
+                }
+                if (part < 0 || *c < '0' || *c > '8')
+                        return -1;
+
+                /* Number of neighbours, optionally followed by '-' and Hensel letters */
+                const int k = *c++ - '0';
+                const int base = (k > 4)? 8-k : k;
+                int negate = 0, n_letters = 0;
+                unsigned int selected = 0;
+                if (*c == '-') {
+                        negate = 1;
+                        c++;
+                }
+                while (*c && islower(tolower(*c)) && toupper(*c) != 'B' && toupper(*c) != 'S') {
+                        const char *l = strchr(letters[base], tolower(*c));
+                        if (!l)
+                                return -1;
+                        selected |= 1u << (l - letters[base]);
+                        n_letters++;
+                        c++;
+                }
+                if ((negate && !n_letters) || (n_letters && (mask & 0x1EF) != 0x1EF))
+                        return -1;
+
+                /* Select all neighbourhoods with k neighbours (and the requested shapes) */
+                for (int n=0; n<512; n++) {
+                        if (((n >> 4) & 1) != part || __builtin_popcount(n & mask & 0x1EF) != k)
+                                continue;
+                        int chosen = 1;
+                        if (n_letters) {
+                                const int shape = (k > 4)? (~n & 0x1EF) : (n & 0x1EF);
+                                int letter = 0;
+                                for (int l=0; letters[base][l]; l++)
+                                        for (int t=0; t<8; t++)
+                                                if (transform_neighbourhood(shapes[base][l], t) == shape)
+                                                        letter = l;
+                                chosen = (int)((selected >> letter) & 1) != negate;
+                        }
+                        if (chosen)
+                                table[n] = 1;
+                }
+        }
+
+        /* Check whether the rule only depends on the state and the number of (Moore) neighbours */
+        *totalistic = 1;
+        for (int n=0; n<512; n++) {
+                int first = n & 0x10; // First neighbourhood with the same state and number of neighbours
+                for (int k=0, bit=0; k<__builtin_popcount(n & ~0x10); bit++)
+                        if (bit != 4) {
+                                first |= 1 << bit;
+                                k++;
+                        }
+                if (table[n] != table[first])
+                        *totalistic = 0;
+        }
+        return 0;
+}
+
+
+/* Strip leading and trailing white space in place */
+static char *rf_trim(char *s) {
+        while (isspace((unsigned char)*s))
+                s++;
+        char *end = s + strlen(s);
+        while (end > s && isspace((unsigned char)end[-1]))
+                *--end = 0;
+        return s;
+}
+
+/* A state (below n_states) or 256 plus the index of the latest variable with that name, -1 if neither */
+static int rf_token(const char *t, char names[][32], int n_vars) {
+        if (isdigit((unsigned char)*t)) {
+                char *end;
+                const long v = strtol(t, &end, 10);
+                return (*end || v >= n_states)? -1 : (int)v;
+        }
+        for (int i=n_vars-1; i>=0; i--)
+                if (!strcmp(names[i], t))
+                        return 256+i;
+        return -1;
+}
+
+/* State table index of a neighbourhood (v[0]: centre, v[1..k]: neighbours) */
+static int rf_index(const int *v, int k) {
+        int idx = 0;
+        for (int j=k; j>=0; j--)
+                idx = idx*n_states + v[j];
+        return idx;
+}
+
+/* Smallest index of a neighbourhood over its symmetric variants: the neighbours rotated by
+ * multiples of step (and mirrored if reflect), or sorted if permute */
+static int rf_canonical(const int *v, int k, int step, int reflect, int permute) {
+        int w[9];
+        w[0] = v[0];
+        if (permute) {
+                for (int i=1; i<=k; i++) {
+                        int j = i;
+                        for (; j>1 && w[j-1] > v[i]; j--)
+                                w[j] = w[j-1];
+                        w[j] = v[i];
+                }
+                return rf_index(w, k);
+        }
+        int best = -1;
+        for (int r=0; r<k; r+=step) {
+                for (int m=0; m<=reflect; m++) {
+                        for (int i=0; i<k; i++)
+                                w[1+i] = v[1 + ((m? k-i : i) + r) % k];
+                        const int idx = rf_index(w, k);
+                        if (best < 0 || idx < best)
+                                best = idx;
+                }
+        }
+        return best;
+}
+
+int load_rule_file(const char *text) {
+        /* Neighbours in the order of the table (clockwise from north) and of the tree as row-major 3x3 positions */
+        static const int ring_moore[8] = {1, 2, 5, 8, 7, 6, 3, 0};      // N NE E SE S SW W NW
+        static const int ring_von_neumann[4] = {1, 5, 7, 3};            // N E S W
+        static const int ring_hexagonal[6] = {1, 5, 8, 7, 3, 0};        // N E SE S W NW
+        static const int tree_moore[9] = {0, 2, 6, 8, 1, 3, 5, 7, 4};   // NW NE SW SE N W E S C
+        static const int tree_von_neumann[5] = {1, 3, 5, 7, 4};         // N W E S C
+
+        /* Variables and transitions of a table (tokens: a state or 256 plus the variable) */
+        static char var_names[RF_MAX_VARS][32];
+        static unsigned char var_values[RF_MAX_VARS][256];
+        static int var_sizes[RF_MAX_VARS];
+        int n_vars = 0, n_trans = 0;
+        int (*trans)[10] = NULL;
+
+        /* Nodes of a tree: the level followed by one child (node or state) per state */
+        int *tree = NULL;
+        int n_nodes = 0, tree_nodes = 0;
+
+        const int *ring = NULL;
+        int section = 0; // 1: @TABLE, 2: @TREE
+        int k = 0, step = 0, reflect = 0, permute = 0, line_no = 0, error = 0;
+        char line[1024];
+        n_states = 0;
+
+        while (*text && !error) {
+                /* Get the next line without comments and surrounding white space */
+                const int len = strcspn(text, "\n");
+                snprintf(line, sizeof(line), "%.*s", len, text);
+                text += len + (text[len] == '\n');
+                line_no++;
+                char *c = strchr(line, '#');
+                if (c)
+                        *c = 0;
+                char *l = rf_trim(line);
+                if (!*l)
+                        continue;
+
+                if (*l == '@') {
+                        if (section)
+                                break; // Only the first table or tree is used
+                        section = !strcmp(l, "@TABLE")? 1 : (!strcmp(l, "@TREE")? 2 : 0);
+                        continue;
+                }
+
+                char *colon = strchr(l, ':'), *eq = strchr(l, '=');
+                if (section == 1 && colon) {
+                        /* Table header */
+                        *colon = 0;
+                        const char *key = rf_trim(l), *value = rf_trim(colon+1);
+                        if (!strcmp(key, "n_states")) {
+                                n_states = atoi(value);
+                        } else if (!strcmp(key, "neighborhood")) {
+                                if (!strcmp(value, "Moore"))
+                                        ring = ring_moore, k = 8;
+                                else if (!strcmp(value, "vonNeumann"))
+                                        ring = ring_von_neumann, k = 4;
+                                else if (!strcmp(value, "hexagonal"))
+                                        ring = ring_hexagonal, k = 6;
+                                else
+                                        error = line_no;
+                                step = k;
+                        } else if (!strcmp(key, "symmetries")) {
+                                const int rotations = strncmp(value, "rotate", 6)? 1 : atoi(value+6);
+                                reflect = strstr(value, "reflect") != NULL;
+                                permute = !strcmp(value, "permute");
+                                if (!k || rotations < 1 || k % rotations ||
+                                    (rotations == 1 && !reflect && !permute && strcmp(value, "none")))
+                                        error = line_no;
+                                else
+                                        step = k / rotations;
+                        }
+                } else if (section == 1 && !strncmp(l, "var", 3) && isspace((unsigned char)l[3])) {
+                        /* Variable: var name={state or variable, ...} */
+                        char *open = strchr(l, '{'), *close = strrchr(l, '}');
+                        if (!eq || !open || !close || open < eq || n_vars == RF_MAX_VARS) {
+                                error = line_no;
+                                continue;
+                        }
+                        *eq = 0;
+                        *close = 0;
+                        snprintf(var_names[n_vars], sizeof(var_names[0]), "%s", rf_trim(l+3));
+                        var_sizes[n_vars] = 0;
+                        for (char *t = strtok(open+1, ","); t && !error; t = strtok(NULL, ",")) {
+                                const int v = rf_token(rf_trim(t), var_names, n_vars);
+                                if (v < 0) {
+                                        error = line_no;
+                                        break;
+                                }
+                                const int n = (v < 256)? 1 : var_sizes[v-256];
+                                for (int i=0; i<n; i++) {
+                                        const int value = (v < 256)? v : var_values[v-256][i];
+                                        if (!memchr(var_values[n_vars], value, var_sizes[n_vars]))
+                                                var_values[n_vars][var_sizes[n_vars]++] = value;
+                                }
+                        }
+                        if (!error && !var_sizes[n_vars])
+                                error = line_no;
+                        n_vars++;
+                } else if (section == 1) {
+                        /* Transition: centre, neighbours and new state, with commas or one character each */
+                        int tokens[11], n_tokens = 0; // One more than possible to detect extra tokens
+                        char single[2] = {0};
+                        if (!k || n_states < 2) {
+                                error = line_no;
+                                continue;
+                        }
+                        if (strchr(l, ',')) {
+                                for (char *t = strtok(l, ","); t && n_tokens < 11; t = strtok(NULL, ","))
+                                        tokens[n_tokens++] = rf_token(rf_trim(t), var_names, n_vars);
+                        } else if (n_states <= 10) {
+                                for (; *l && n_tokens < 11; l++) {
+                                        if (isspace((unsigned char)*l))
+                                                continue;
+                                        single[0] = *l;
+                                        tokens[n_tokens++] = rf_token(single, var_names, n_vars);
+                                }
+                        }
+                        if (n_tokens != k+2) {
+                                error = line_no;
+                                continue;
+                        }
+                        int bound = tokens[k+1] < 256; // A variable as new state must appear before
+                        for (int j=0; j<k+2; j++) {
+                                if (tokens[j] < 0)
+                                        error = line_no;
+                                if (j <= k && tokens[j] == tokens[k+1])
+                                        bound = 1;
+                        }
+                        if (!bound)
+                                error = line_no;
+                        if (error)
+                                continue;
+                        trans = realloc(trans, sizeof(*trans) * (n_trans+1));
+                        memcpy(trans[n_trans++], tokens, sizeof(*trans));
+                } else if (section == 2 && eq) {
+                        /* Tree header */
+                        *eq = 0;
+                        const char *key = rf_trim(l);
+                        const int value = atoi(eq+1);
+                        if (!strcmp(key, "num_states"))
+                                n_states = value;
+                        else if (!strcmp(key, "num_neighbors") && (value == 4 || value == 8))
+                                ring = (value == 8)? ring_moore : ring_von_neumann, k = value;
+                        else if (!strcmp(key, "num_nodes") && value > 0 && n_states >= 2 && n_states <= 255 && !tree)
+                                tree = malloc(sizeof(int) * value*(n_states+1)), tree_nodes = value;
+                        else
+                                error = line_no;
+                } else if (section == 2) {
+                        /* Tree node: level and one child per state (a state on level 1, a previous node above) */
+                        if (n_nodes == tree_nodes) {
+                                error = line_no;
+                                continue;
+                        }
+                        int *node = &tree[n_nodes*(n_states+1)];
+                        char *p = l;
+                        for (int i=0; i<=n_states && !error; i++) {
+                                char *end;
+                                node[i] = (int)strtol(p, &end, 10);
+                                if (end == p || node[i] < 0 || (i && node[i] >= ((node[0] == 1)? n_states : n_nodes)) ||
+                                    (i && node[0] > 1 && tree[node[i]*(n_states+1)] != node[0]-1))
+                                        error = line_no;
+                                p = end;
+                        }
+                        if (*rf_trim(p))
+                                error = line_no;
+                        n_nodes++;
+                }
+        }
+
+        /* Check that the table or tree is complete and the state table is small enough */
+        long size = 1;
+        for (int j=0; j<=k && size <= RF_MAX_TABLE; j++)
+                size *= n_states;
+        if (!error && (!section || !k || n_states < 2 || n_states > 255 || size > RF_MAX_TABLE ||
+                       (section == 2 && (!n_nodes || n_nodes < tree_nodes || tree[(n_nodes-1)*(n_states+1)] != k+1))))
+                error = -1;
+        if (error) {
+                free(trans);
+                free(tree);
+                return error;
+        }
+
+        table_cells = k+1;
+        table_pos[0] = 4;
+        table_mask = 0;
+        for (int i=0; i<k; i++) {
+                table_pos[1+i] = ring[i];
+                table_mask |= 1 << ring[i];
+        }
+        free(state_table);
+        state_table = malloc(size);
+
+        int v[9];
+        if (section == 1) {
+                /* The first transition that matches a neighbourhood (with any symmetry) wins */
+                unsigned char *first = malloc(size);
+                memset(first, 0xFF, size);
+                for (int t=0; t<n_trans; t++) {
+                        /* Enumerate all values of the distinct variables of the transition */
+                        int vars[10], choice[10] = {0}, n_distinct = 0;
+                        for (int j=0; j<=k; j++) {
+                                int d = 0;
+                                while (d < n_distinct && vars[d] != trans[t][j])
+                                        d++;
+                                if (trans[t][j] >= 256 && d == n_distinct)
+                                        vars[n_distinct++] = trans[t][j];
+                        }
+                        while (1) {
+                                int next = trans[t][k+1];
+                                for (int j=0; j<=k+1; j++) {
+                                        int value = trans[t][j];
+                                        for (int d=0; d<n_distinct; d++)
+                                                if (vars[d] == value)
+                                                        value = var_values[value-256][choice[d]];
+                                        if (j <= k)
+                                                v[j] = value;
+                                        else
+                                                next = value;
+                                }
+                                const int idx = rf_canonical(v, k, step, reflect, permute);
+                                if (first[idx] == 0xFF)
+                                        first[idx] = next;
+
+                                int d = 0;
+                                for (; d<n_distinct; d++) {
+                                        if (++choice[d] < var_sizes[vars[d]-256])
+                                                break;
+                                        choice[d] = 0;
+                                }
+                                if (d == n_distinct)
+                                        break;
+                        }
+                }
+
+                /* Neighbourhoods without a transition keep their state */
+                for (long i=0; i<size; i++) {
+                        long n = i;
+                        for (int j=0; j<=k; j++, n/=n_states)
+                                v[j] = n % n_states;
+                        const int idx = rf_canonical(v, k, step, reflect, permute);
+                        state_table[i] = (first[idx] == 0xFF)? v[0] : first[idx];
+                }
+                free(first);
+        } else {
+                /* Walk down the tree from the root (the last node) */
+                const int *order = (k == 8)? tree_moore : tree_von_neumann;
+                int cells[9] = {0};
+                for (long i=0; i<size; i++) {
+                        long n = i;
+                        for (int j=0; j<=k; j++, n/=n_states)
+                                cells[table_pos[j]] = n % n_states;
+                        int node = n_nodes-1;
+                        for (int j=0; j<=k; j++)
+                                node = tree[node*(n_states+1) + 1+cells[order[j]]];
+                        state_table[i] = node;
+                }
+        }
+
+        free(trans);
+        free(tree);
+        return 0;
+}
+
+
+int parse_margolus(const char *rule, unsigned char table[16]) {
+        /* Skip the "MS,D" prefix */
+        const char *c = strchr(rule, 'D');
+        c = c? c+1 : rule;
+        for (int i=0; i<16; i++) {
+                while (*c == ';' || *c == ',' || isspace((unsigned char)*c))
+                        c++;
+                if (!isdigit((unsigned char)*c))
+                        return -1;
+                char *end;
+                const long v = strtol(c, &end, 10);
+                if (v > 15)
+                        return -1;
+                table[i] = v;
+                c = end;
+        }
+        while (isspace((unsigned char)*c))
+                c++;
+        return *c? -1 : 0;
+}
+
+
+/* Add a 2 bit number (b0, b1) to a bit-sliced 5 bit counter */
+static void add_2bit(uint64_t acc[5], uint64_t b0, uint64_t b1) {
+        uint64_t carry = acc[0] & b0;
+        acc[0] ^= b0;
+        const uint64_t t = acc[1] ^ b1;
+        const uint64_t c1 = (acc[1] & b1) | (t & carry);
+        acc[1] = t ^ carry;
+        carry = c1;
+        for (int i=2; i<5; i++) {
+                const uint64_t c = acc[i] & carry;
+                acc[i] ^= carry;
+                carry = c;
+        }
+}
+
+/* Bit-sliced mask of the counters equal to v */
+static uint64_t count_equals(const uint64_t acc[5], int v) {
+        uint64_t eq = ~(uint64_t)0;
+        for (int i=0; i<5; i++)
+                eq &= ((v >> i) & 1)? acc[i] : ~acc[i];
+        return eq;
+}
+
+void run_3d(int my_rank, int size) {
+        /* Parse the rule */
+        int el, eu, fl, fu;
+        if (sscanf(RULE_3D, "%d,%d,%d,%d", &el, &eu, &fl, &fu) != 4) {
+                if (strlen(RULE_3D) != 4) {
+                        if (!my_rank)
+                                fprintf(stdout, "Invalid 3D rule, aborting (rule = %s).\n", RULE_3D);
+                        exit(1);
+                }
+                el = RULE_3D[0]-'0';
+                eu = RULE_3D[1]-'0';
+                fl = RULE_3D[2]-'0';
+                fu = RULE_3D[3]-'0';
+        }
+
+        /* Create the periodic 3D grid of processors (dimension 0: z, 1: y, 2: x) */
+        int dims[3] = {0, 0, 0}, periods[3] = {1, 1, 1}, coords[3];
+        MPI_Comm cart;
+        MPI_Dims_create(size, 3, dims);
+        MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 1, &cart);
+        MPI_Comm_rank(cart, &my_rank);
+        MPI_Cart_coords(cart, my_rank, 3, coords);
+
+        int n[3], p[3]; // Local box size without and with the ghost layers
+        for (int d=0; d<3; d++) {
+                if (GRID_WIDTH % dims[d]) {
+                        if (!my_rank)
+                                fprintf(stdout, "Processor grid %dx%dx%d does not divide the cube (N = %d).\n", dims[0], dims[1], dims[2], GRID_WIDTH);
+                        exit(1);
+                }
+                n[d] = GRID_WIDTH / dims[d];
+                p[d] = n[d]+2;
+        }
+        const int plane = p[1]*p[2];
+        unsigned char *cells = calloc(p[0]*plane, 1);
+        unsigned char *next = calloc(p[0]*plane, 1);
+
+        /* Fill the centre cube (half the width) randomly, independent of the decomposition (see RANDOM_SEED) */
+        unsigned long seed = RANDOM_SEED? RANDOM_SEED : time(NULL);
+        MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG, 0, cart);
+        for (int z=0; z<n[0]; z++) {
+                for (int y=0; y<n[1]; y++) {
+                        for (int x=0; x<n[2]; x++) {
+                                const long gz = coords[0]*n[0]+z, gy = coords[1]*n[1]+y, gx = coords[2]*n[2]+x;
+                                if (gz < GRID_WIDTH/4 || gz >= GRID_WIDTH*3/4 || gy < GRID_WIDTH/4 || gy >= GRID_WIDTH*3/4 ||
+                                    gx < GRID_WIDTH/4 || gx >= GRID_WIDTH*3/4)
+                                        continue;
+                                uint64_t h = seed + ((gz*GRID_WIDTH + gy)*GRID_WIDTH + gx) * 0x9E3779B97F4A7C15ull;
+                                h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull; // splitmix64 finaliser
+                                h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+                                cells[(z+1)*plane + (y+1)*p[2] + x+1] = (h ^ (h >> 31)) & 1;
+                        }
+                }
+        }
+
+        /* Subarray types of the layers to send and receive in every dimension. Dimensions that
+         * are exchanged earlier are included with their ghost layers, later ones without. */
+        MPI_Datatype send_lo[3], send_hi[3], recv_lo[3], recv_hi[3];
+        for (int d=0; d<3; d++) {
+                int sub[3], start[3];
+                for (int e=0; e<3; e++) {
+                        sub[e] = (e < d)? p[e] : n[e];
+                        start[e] = (e < d)? 0 : 1;
+                }
+                sub[d] = 1;
+                MPI_Datatype *types[4] = {&send_lo[d], &send_hi[d], &recv_lo[d], &recv_hi[d]};
+                const int layers[4] = {1, n[d], 0, n[d]+1};
+                for (int i=0; i<4; i++) {
+                        start[d] = layers[i];
+                        MPI_Type_create_subarray(3, p, sub, start, MPI_ORDER_C, MPI_UNSIGNED_CHAR, types[i]);
+                        MPI_Type_commit(types[i]);
+                }
+        }
+
+        /* Bit rows along x (bit x holds cell x of the padded row) */
+        const int words = (p[2]+63)/64;
+        uint64_t *rows = calloc(p[0]*p[1]*words, sizeof(uint64_t));
+
+        if (!my_rank)
+                fprintf(stdout, "3D grid %dx%dx%d on %dx%dx%d processors, rule %d%d%d%d\n",
+                        GRID_WIDTH, GRID_WIDTH, GRID_WIDTH, dims[0], dims[1], dims[2], el, eu, fl, fu);
+
+        for (int gen=0; gen < N_GENERATIONS; gen++) {
+                /* Count and print the population */
+                long local_pop = 0, pop = 0;
+                for (int z=1; z<=n[0]; z++)
+                        for (int y=1; y<=n[1]; y++)
+                                for (int x=1; x<=n[2]; x++)
+                                        local_pop += cells[z*plane + y*p[2] + x];
+                MPI_Reduce(&local_pop, &pop, 1, MPI_LONG, MPI_SUM, 0, cart);
+                if (!my_rank) {
+                        fprintf(stdout, "Generation: %d|%d Population: %ld\n", gen, N_GENERATIONS-1, pop);
+                        fflush(stdout);
+                }
+
+                /* Exchange the ghost layers one dimension after the other */
+                for (int d=0; d<3; d++) {
+                        int lo, hi;
+                        MPI_Cart_shift(cart, d, 1, &lo, &hi);
+                        MPI_Sendrecv(cells, 1, send_lo[d], lo, TAG_HI, cells, 1, recv_hi[d], hi, TAG_HI, cart, MPI_STATUS_IGNORE);
+                        MPI_Sendrecv(cells, 1, send_hi[d], hi, TAG_LO, cells, 1, recv_lo[d], lo, TAG_LO, cart, MPI_STATUS_IGNORE);
+                }
+
+                /* Pack all rows (including the ghost layers) into bits */
+                memset(rows, 0, sizeof(uint64_t) * p[0]*p[1]*words);
+                for (int zy=0; zy<p[0]*p[1]; zy++)
+                        for (int x=0; x<p[2]; x++)
+                                rows[zy*words + x/64] |= (uint64_t)cells[zy*p[2] + x] << (x%64);
+
+                /* Bit-sliced update: sum the 27 cells of every neighbourhood (including the centre) */
+                for (int z=1; z<=n[0]; z++) {
+                        for (int y=1; y<=n[1]; y++) {
+                                for (int k=0; k<words; k++) {
+                                        uint64_t acc[5] = {0, 0, 0, 0, 0};
+                                        for (int dz=-1; dz<=1; dz++) {
+                                                for (int dy=-1; dy<=1; dy++) {
+                                                        const uint64_t *r = &rows[((z+dz)*p[1] + y+dy)*words];
+                                                        const uint64_t c = r[k];
+                                                        const uint64_t l = (c << 1) | (k? r[k-1] >> 63 : 0);          // cell x-1
+                                                        const uint64_t rt = (c >> 1) | (k+1 < words? r[k+1] << 63 : 0); // cell x+1
+
+                                                        /* Full adder of the three cells of this row */
+                                                        add_2bit(acc, l ^ c ^ rt, (l & c) | (rt & (l ^ c)));
+                                                }
+                                        }
+
+                                        /* Apply the rule (the sum includes the centre cell) */
+                                        const uint64_t alive = rows[(z*p[1] + y)*words + k];
+                                        uint64_t survive = 0, born = 0;
+                                        for (int v=el; v<=eu; v++)
+                                                survive |= count_equals(acc, v+1);
+                                        for (int v=fl; v<=fu; v++)
+                                                born |= count_equals(acc, v);
+                                        const uint64_t result = (alive & survive) | (~alive & born);
+
+                                        /* Unpack the interior cells of this word */
+                                        unsigned char *out = &next[z*plane + y*p[2]];
+                                        for (int x=(k? 64*k : 1); x<64*(k+1) && x<=n[2]; x++)
+                                                out[x] = (result >> (x%64)) & 1;
+                                }
+                        }
+                }
+
+                unsigned char *tmp = cells;
+                cells = next;
+                next = tmp;
+
+                /* Generation delay */
+                usleep(GEN_DELAY_MS*1000);
+        }
+
+        /* Free the pointers */
+        for (int d=0; d<3; d++) {
+                MPI_Type_free(&send_lo[d]);
+                MPI_Type_free(&send_hi[d]);
+                MPI_Type_free(&recv_lo[d]);
+                MPI_Type_free(&recv_hi[d]);
+        }
+        free(cells);
+        free(next);
+        free(rows);
+        MPI_Comm_free(&cart);
+}
+
+
+/* State of the out-of-core engine */
+static struct {
+        int width;              // Length of one side of the block
+        int depth;              // Generations per pass (depth of the ghost ring)
+        int stride;             // Length of a row of the band buffers (width+2*depth plus a spare column)
+        unsigned char *cells;   // The block, mapped from its file
+        int *top, *bottom;      // First / last depth rows of the block (width values each)
+        int *left, *right;      // First / last depth columns of every row of the block
+        int *up_halo, *down_halo;       // Ghost rows above / below, including the corners (width+2*depth values each)
+        int *left_halo, *right_halo;    // Ghost columns (depth values per row)
+        int **bands;            // Band buffers of the generations 0..depth-1 of a pass
+        int *out;               // Band of the last generation of a pass
+} ooc;
+
+/* Write a row of the block and keep the cells the neighbours need for the next pass. Returns its population. */
+static long long ooc_store_row(int y, const int *row) {
+        const int width = ooc.width, depth = ooc.depth;
+        unsigned char *cells = ooc.cells + (size_t)y*width;
+        long long population = 0;
+        for (int x=0; x<width; x++) {
+                cells[x] = row[x];
+                population += (row[x] != 0);
+        }
+        if (y < depth)
+                memcpy(&ooc.top[y*width], row, sizeof(int)*width);
+        if (y >= width-depth)
+                memcpy(&ooc.bottom[(y-width+depth)*width], row, sizeof(int)*width);
+        memcpy(&ooc.left[y*depth], row, sizeof(int)*depth);
+        memcpy(&ooc.right[y*depth], row+width-depth, sizeof(int)*depth);
+        return population;
+}
+
+/* Exchange the ghost ring of depth cells like exchange_deep, from the saved rows and columns */
+static void ooc_exchange(int neigh_procs[8]) {
+        const int width = ooc.width, depth = ooc.depth, deep = width+2*depth;
+
+        /* Phase 1: swap depth columns with the left and right neighbours */
+        MPI_Sendrecv(ooc.left, width*depth, MPI_INT, neigh_procs[3], TAG_RI,
+                     ooc.right_halo, width*depth, MPI_INT, neigh_procs[4], TAG_RI, compute_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(ooc.right, width*depth, MPI_INT, neigh_procs[4], TAG_LE,
+                     ooc.left_halo, width*depth, MPI_INT, neigh_procs[3], TAG_LE, compute_comm, MPI_STATUS_IGNORE);
+
+        /* Phase 2: swap depth full-width rows (including the ghost columns) with the upper and lower neighbours */
+        int *rows = malloc(sizeof(int) * depth*deep);
+        for (int lower=0; lower<2; lower++) {
+                const int y0 = lower? width-depth : 0;
+                for (int y=0; y<depth; y++) {
+                        memcpy(&rows[y*deep], &ooc.left_halo[(y0+y)*depth], sizeof(int)*depth);
+                        memcpy(&rows[y*deep+depth], &(lower? ooc.bottom : ooc.top)[y*width], sizeof(int)*width);
+                        memcpy(&rows[y*deep+depth+width], &ooc.right_halo[(y0+y)*depth], sizeof(int)*depth);
+                }
+                if (!lower)
+                        MPI_Sendrecv(rows, depth*deep, MPI_INT, neigh_procs[1], TAG_DO,
+                                     ooc.down_halo, depth*deep, MPI_INT, neigh_procs[6], TAG_DO, compute_comm, MPI_STATUS_IGNORE);
+                else
+                        MPI_Sendrecv(rows, depth*deep, MPI_INT, neigh_procs[6], TAG_UP,
+                                     ooc.up_halo, depth*deep, MPI_INT, neigh_procs[1], TAG_UP, compute_comm, MPI_STATUS_IGNORE);
+        }
+
+        /* Free the pointers */
+        free(rows);
+}
+
+/* Advance the block by depth generations in one pass over the file. Returns the new population. */
+static long long ooc_pass(int gen) {
+        const int width = ooc.width, depth = ooc.depth, deep = width+2*depth, stride = ooc.stride;
+
+        /* Generation t of the pass covers the rows t-depth .. width+depth-t-1 of the block (one ring
+         * less per generation). next[t] is the next row to compute, first[t] the row in band t's first line. */
+        int *next = malloc(sizeof(int) * (depth+1));
+        int *first = malloc(sizeof(int) * (depth+1));
+        for (int t=0; t<=depth; t++)
+                next[t] = first[t] = t-depth;
+
+        long long population = 0;
+        while (next[depth] < width) {
+                /* Read the next band with its ghost cells */
+                for (int n=0; n<OOC_BAND && next[0] < width+depth; n++, next[0]++) {
+                        const int y = next[0];
+                        int *row = &ooc.bands[0][(y-first[0])*stride];
+                        if (y < 0) {
+                                memcpy(row, &ooc.up_halo[(y+depth)*deep], sizeof(int)*deep);
+                        } else if (y >= width) {
+                                memcpy(row, &ooc.down_halo[(y-width)*deep], sizeof(int)*deep);
+                        } else {
+                                const unsigned char *cells = ooc.cells + (size_t)y*width;
+                                memcpy(row, &ooc.left_halo[y*depth], sizeof(int)*depth);
+                                for (int x=0; x<width; x++)
+                                        row[depth+x] = cells[x];
+                                memcpy(row+depth+width, &ooc.right_halo[y*depth], sizeof(int)*depth);
+                        }
+                }
+
+                /* Advance the rows through the generations as far as the generation before allows */
+                for (int t=1; t<=depth; t++) {
+                        const int end = (next[t-1]-1 < width+depth-t)? next[t-1]-1 : width+depth-t;
+                        const int h = end-next[t];
+                        if (h <= 0)
+                                continue;
+                        const int *cg = &ooc.bands[t-1][(next[t]-1-first[t-1])*stride];
+                        if (t < depth) {
+                                step_region(&ooc.bands[t][(next[t]-first[t])*stride], stride, deep-2*t, h, cg, stride,
+                                            gen+t-1, local_y0+next[t], local_x0+t-depth);
+                        } else {
+                                /* The last generation goes back into the file */
+                                step_region(ooc.out, width, width, h, cg, stride, gen+t-1, local_y0+next[t], local_x0);
+                                for (int y=0; y<h; y++)
+                                        population += ooc_store_row(next[t]+y, &ooc.out[y*width]);
+                        }
+                        next[t] = end;
+
+                        /* Keep the two rows of generation t-1 that the next band still needs */
+                        memmove(ooc.bands[t-1], &ooc.bands[t-1][(next[t]-1-first[t-1])*stride], sizeof(int) * (next[t-1]-next[t]+1)*stride);
+                        first[t-1] = next[t]-1;
+                }
+        }
+
+        /* Free the pointers */
+        free(next);
+        free(first);
+        return population;
+}
+
+void run_out_of_core(int my_rank, int size) {
+        const int ppl = (int)sqrt(size);
+        if (GRID_WIDTH % ppl || HALO_DEPTH > GRID_WIDTH/ppl || OOC_BAND < 1) {
+                if (!my_rank)
+                        fprintf(stdout, "Invalid out-of-core block, aborting (local_grid_edge = %d, depth = %d, band = %d).\n",
+                                GRID_WIDTH/ppl, HALO_DEPTH, OOC_BAND);
+                exit(1);
+        }
+        const int width = GRID_WIDTH/ppl, depth = HALO_DEPTH;
+        ooc.width = width;
+        ooc.depth = depth;
+        ooc.stride = width+2*depth+1;
+
+        /* Place the block and find the neighbours like the in-memory engine */
+        int *block_of_rank = malloc(sizeof(int) * size);
+        int *rank_of_block = malloc(sizeof(int) * size);
+        get_block_layout(block_of_rank, rank_of_block, my_rank, size);
+        local_y0 = block_of_rank[my_rank] / ppl * width;
+        local_x0 = block_of_rank[my_rank] % ppl * width;
+        int neigh_procs[8];
+        get_neighbour_ids(neigh_procs, block_of_rank[my_rank], size);
+        for (int i=0; i<8; i++)
+                neigh_procs[i] = rank_of_block[neigh_procs[i]];
+        random_seed = RANDOM_SEED? RANDOM_SEED : (uint32_t)time(NULL);
+        MPI_Bcast(&random_seed, 1, MPI_UINT32_T, 0, compute_comm);
+
+        /* Map the block file */
+        char name[256];
+        snprintf(name, sizeof(name), OOC_FILE, my_rank);
+        const size_t bytes = (size_t)width*width;
+        const int fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, bytes) ||
+            (ooc.cells = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+                fprintf(stdout, "Cannot map the block file, aborting (block file = %s).\n", name);
+                exit(1);
+        }
+        madvise(ooc.cells, bytes, MADV_SEQUENTIAL);
+
+        /* Allocate the saved rows and columns, the ghost ring and the band buffers (plus a spare row, see step_region) */
+        ooc.top = malloc(sizeof(int) * depth*width);
+        ooc.bottom = malloc(sizeof(int) * depth*width);
+        ooc.left = malloc(sizeof(int) * width*depth);
+        ooc.right = malloc(sizeof(int) * width*depth);
+        ooc.up_halo = malloc(sizeof(int) * depth*(width+2*depth));
+        ooc.down_halo = malloc(sizeof(int) * depth*(width+2*depth));
+        ooc.left_halo = malloc(sizeof(int) * width*depth);
+        ooc.right_halo = malloc(sizeof(int) * width*depth);
+        ooc.bands = malloc(sizeof(int *) * depth);
+        for (int t=0; t<depth; t++)
+                ooc.bands[t] = calloc((size_t)(OOC_BAND+3)*ooc.stride, sizeof(int));
+        ooc.out = calloc((size_t)OOC_BAND*width, sizeof(int));
+
+        /* Initialise the block row by row, independent of the decomposition */
+        size_t board_length = 0;
+        int board_tile = 0;
+        const unsigned char *board = BOARD_FILE[0]? map_board(&board_length, &board_tile) : NULL;
+        long long population = 0;
+        for (int y=0; y<width; y++) {
+                const int gy = local_y0+y;
+                if (board) {
+                        unpack_board_row(board, board_tile, gy, local_x0, width, ooc.out);
+                        population += ooc_store_row(y, ooc.out);
+                        continue;
+                }
+                for (int x=0; x<width; x++)
+                        ooc.out[x] = start_cell(gy, local_x0+x);
+                population += ooc_store_row(y, ooc.out);
+        }
+        if (board)
+                munmap((void *)board, board_length);
+
+        if (!my_rank)
+                fprintf(stdout, "Out-of-core grid %dx%d on %d processors, %d generations per pass in bands of %d rows\n",
+                        GRID_WIDTH, GRID_WIDTH, size, depth, OOC_BAND);
+
+        for (int gen=0; gen < N_GENERATIONS; gen+=depth) {
+                /* Print the population */
+                long long total = 0;
+                MPI_Reduce(&population, &total, 1, MPI_LONG_LONG, MPI_SUM, 0, compute_comm);
+                if (!my_rank) {
+                        fprintf(stdout, "Generation: %d|%d Population: %lld\n", gen, N_GENERATIONS-1, total);
+                        fflush(stdout);
+                }
+
+                ooc_exchange(neigh_procs);
+                population = ooc_pass(gen);
+        }
+
+        /* Free the pointers */
+        munmap(ooc.cells, bytes);
+        close(fd);
+        free(ooc.top);
+        free(ooc.bottom);
+        free(ooc.left);
+        free(ooc.right);
+        free(ooc.up_halo);
+        free(ooc.down_halo);
+        free(ooc.left_halo);
+        free(ooc.right_halo);
+        for (int t=0; t<depth; t++)
+                free(ooc.bands[t]);
+        free(ooc.bands);
+        free(ooc.out);
+        free(block_of_rank);
+        free(rank_of_block);
+}